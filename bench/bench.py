@@ -0,0 +1,190 @@
+#!/usr/bin/python
+
+# Benchmarks cromple on generated synthetic projects.
+# Times cold, no-op, one-leaf-touched and one-shared-header-touched builds and counts how many processes cromple spawned.
+# Results are saved as JSON so runs before and after a change can be compared with "--compare".
+
+import os
+import sys
+import json
+import time
+import shutil
+import pathlib
+import argparse
+import platform
+import tempfile
+import statistics
+import subprocess
+
+repo_root = os.path.normpath(os.path.join(os.path.dirname(__file__), ".."))
+default_executable = os.path.join(repo_root, "bin", "cromple")
+
+def positive(value):
+	"""argparse type for counts that must be at least 1. The generated project or the statistics make no sense otherwise."""
+	number = int(value)
+	if number < 1:
+		raise argparse.ArgumentTypeError(f"must be at least 1 but got {number}")
+	return number
+
+parser = argparse.ArgumentParser(description="Benchmark cromple on a generated synthetic project.")
+parser.add_argument("--cromple", default=default_executable, help="cromple executable to benchmark.")
+parser.add_argument("--compiler", default="/usr/bin/g++", help="Compiler cromple wraps.")
+parser.add_argument("--units", type=positive, default=50, help="Number of translation units.")
+parser.add_argument("--depth", type=positive, default=4, help="Number of header levels below the units.")
+parser.add_argument("--width", type=positive, default=8, help="Number of headers per level.")
+parser.add_argument("--fan-in", type=int, default=3, help="Number of headers each unit and header includes from the level below.")
+parser.add_argument("--templates", type=int, default=20, help="Recursive template instantiation depth per included header. Makes compiles more expensive.")
+parser.add_argument("--repeat", type=positive, default=3, help="Number of times each scenario is run. The median is reported.")
+parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="Passed to cromple \"--jobs\".")
+parser.add_argument("--output", help="Write results as JSON to this file.")
+parser.add_argument("--compare", help="JSON results of a previous run to compare against.")
+parser.add_argument("--keep", action="store_true", help="Keep the generated project and print where it is.")
+arguments = parser.parse_args()
+
+def header_name(level, index):
+	return f"h{level}_{index}.hpp"
+
+def includes_of(level, index):
+	"""Headers from the level below (level - 1) included by header index on level. Spread so every header is used."""
+	return [header_name(level - 1, (index * arguments.fan_in + i) % arguments.width) for i in range(min(arguments.fan_in, arguments.width))]
+
+def generate(root):
+	"""Generates a project with a header DAG. Level 0 headers include nothing and are the most shared."""
+	source_directory = os.path.join(root, "src")
+	include_directory = os.path.join(root, "include")
+	os.makedirs(source_directory)
+	os.makedirs(include_directory)
+	os.makedirs(os.path.join(root, "obj"))
+
+	for level in range(arguments.depth):
+		for index in range(arguments.width):
+			name = f"h{level}_{index}"
+			includes = includes_of(level, index) if level > 0 else []
+			with open(os.path.join(include_directory, header_name(level, index)), "w") as file:
+				file.write("#pragma once\n")
+				for include in includes:
+					file.write(f"#include \"{include}\"\n")
+				# Recursive template so each instantiation costs frontend time.
+				file.write(f"template<int N> struct {name} {{ static constexpr long value = {name}<N - 1>::value + N; }};\n")
+				file.write(f"template<> struct {name}<0> {{ static constexpr long value = 0; }};\n")
+
+	top = arguments.depth - 1
+	for unit in range(arguments.units):
+		includes = [header_name(top, (unit * arguments.fan_in + i) % arguments.width) for i in range(min(arguments.fan_in, arguments.width))]
+		with open(os.path.join(source_directory, f"unit{unit}.cpp"), "w") as file:
+			for include in includes:
+				file.write(f"#include \"{include}\"\n")
+			values = " + ".join(f"{include[:-4]}<{arguments.templates}>::value" for include in includes)
+			file.write(f"long unit{unit}() {{ return {values}; }}\n")
+
+	with open(os.path.join(source_directory, "main.cpp"), "w") as file:
+		for unit in range(arguments.units):
+			file.write(f"long unit{unit}();\n")
+		file.write("int main() {\n\tlong sum = 0;\n")
+		for unit in range(arguments.units):
+			file.write(f"\tsum += unit{unit}();\n")
+		file.write("\treturn sum == 0;\n}\n")
+
+	return source_directory, include_directory
+
+def write_counting_compiler(root):
+	"""Compiler wrapper that logs each invocation so process spawns can be counted."""
+	log = os.path.join(root, "spawns.log")
+	wrapper = os.path.join(root, "compiler.sh")
+	with open(wrapper, "w") as file:
+		file.write(f"#!/bin/sh\necho x >> '{log}'\nexec '{arguments.compiler}' \"$@\"\n")
+	os.chmod(wrapper, 0o755)
+	return wrapper, log
+
+def run_build(command, log):
+	"""Runs one build and returns wall time in seconds and number of compiler processes spawned."""
+	if os.path.exists(log):
+		os.remove(log)
+	start = time.perf_counter()
+	subprocess.run(command, check=True)
+	wall = time.perf_counter() - start
+	spawns = 0
+	if os.path.exists(log):
+		with open(log) as file:
+			spawns = len(file.readlines())
+	return wall, spawns
+
+def touch(path):
+	# Assumes a filesystem with high resolution modification times. Run from a tmpfs or ext4 temporary directory, not sshfs.
+	pathlib.Path(path).touch()
+
+root = tempfile.mkdtemp(prefix="cromple-bench-")
+try:
+	source_directory, include_directory = generate(root)
+	compiler, log = write_counting_compiler(root)
+	object_directory = os.path.join(root, "obj")
+	command = [arguments.cromple, "--compiler", compiler, "--source", source_directory, "--objects", object_directory, "--jobs", str(arguments.jobs), "-I", include_directory, "-o", os.path.join(root, "a.out")]
+
+	def clean():
+		shutil.rmtree(object_directory)
+		os.makedirs(object_directory)
+
+	# Each scenario prepares the tree, then the build is measured.
+	scenarios = {
+		"cold": clean,
+		"no-op": lambda: None,
+		"leaf-touched": lambda: touch(os.path.join(source_directory, "unit0.cpp")),
+		"shared-header-touched": lambda: touch(os.path.join(include_directory, header_name(0, 0))),
+	}
+
+	results = {}
+	# Make sure the tree is built before the incremental scenarios.
+	run_build(command, log)
+	for name, prepare in scenarios.items():
+		walls = []
+		spawns = []
+		for _ in range(arguments.repeat):
+			prepare()
+			wall, spawn_count = run_build(command, log)
+			walls.append(wall)
+			spawns.append(spawn_count)
+		results[name] = {
+			"wall_seconds": statistics.median(walls),
+			"wall_seconds_all": walls,
+			"spawns": statistics.median_low(spawns),
+		}
+		print(f"{name:<22} {results[name]['wall_seconds']:>9.3f}s {results[name]['spawns']:>6} spawns", flush=True)
+
+	report = {
+		"project": {
+			"units": arguments.units,
+			"depth": arguments.depth,
+			"width": arguments.width,
+			"fan_in": arguments.fan_in,
+			"templates": arguments.templates,
+		},
+		"jobs": arguments.jobs,
+		"repeat": arguments.repeat,
+		"cromple": arguments.cromple,
+		"compiler": arguments.compiler,
+		"machine": platform.node(),
+		"time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+		"scenarios": results,
+	}
+
+	if arguments.output:
+		with open(arguments.output, "w") as file:
+			json.dump(report, file, indent="\t")
+
+	if arguments.compare:
+		with open(arguments.compare) as file:
+			baseline = json.load(file)
+		if baseline["project"] != report["project"]:
+			print("Warning: the baseline was generated with different project parameters.", file=sys.stderr)
+		print("Compared to", arguments.compare)
+		for name, result in results.items():
+			if name not in baseline["scenarios"]:
+				continue
+			before = baseline["scenarios"][name]
+			change = (result["wall_seconds"] / before["wall_seconds"] - 1) * 100 if before["wall_seconds"] > 0 else 0
+			print(f"{name:<22} {before['wall_seconds']:>9.3f}s -> {result['wall_seconds']:>9.3f}s ({change:+.1f}%) {before['spawns']:>6} -> {result['spawns']} spawns")
+finally:
+	if arguments.keep:
+		print("Generated project kept in", root)
+	else:
+		shutil.rmtree(root)
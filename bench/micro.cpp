@@ -0,0 +1,299 @@
+// Microbenchmarks of cromple's own overheads: spawning processes, reading their output, parsing make rules and stat'ing files.
+// Every benchmark runs on fixed inputs so results of runs before and after a change can be compared.
+// Prints nanoseconds and heap allocations per operation. Allocations are counted by replacing every form of the global operator new.
+//
+// Usage: cromple-micro [NAME]...
+// Only runs the benchmarks whose names contain one of NAME. Runs all without NAME.
+
+#include <new>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <filesystem>
+
+#include <unistd.h>
+
+#include "error.hpp"
+#include "process.hpp"
+#include "compiler.hpp"
+#include "manifest.hpp"
+
+// Number of calls to any global operator new since the start of the program. cromple-micro is single threaded.
+static std::size_t allocations = 0;
+
+// Counts and allocates like every replaced operator new. Returns nullptr when out of memory so each form can throw or not.
+static void *
+allocate(std::size_t size) {
+	allocations++;
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+// std::aligned_alloc needs a size that is a multiple of the alignment.
+static void *
+allocate(std::size_t size, std::align_val_t alignment) {
+	allocations++;
+	std::size_t align = static_cast<std::size_t>(alignment);
+	return std::aligned_alloc(align, size == 0 ? align : (size + align - 1) / align * align);
+}
+
+// All forms of operator new are replaced so allocations through new[], aligned or nothrow new are counted too.
+void *
+operator new(std::size_t size) {
+	if (void *pointer = allocate(size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *
+operator new[](std::size_t size) {
+	if (void *pointer = allocate(size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *
+operator new(std::size_t size, std::align_val_t alignment) {
+	if (void *pointer = allocate(size, alignment)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *
+operator new[](std::size_t size, std::align_val_t alignment) {
+	if (void *pointer = allocate(size, alignment)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *
+operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void *
+operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void *
+operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return allocate(size, alignment);
+}
+
+void *
+operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return allocate(size, alignment);
+}
+
+// Both malloc and aligned_alloc memory is released with free, so every form of operator delete is the same.
+void
+operator delete(void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete(void *pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete(void *pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete(void *pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void
+operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+class benchmark {
+	public:
+	std::string name;
+	// Times run is called. Kept fixed, not adapted to the machine, so allocations per operation are comparable between runs.
+	std::size_t iterations;
+	// Operations done by one call to run, e.g. the number of files stat'ed.
+	std::size_t operations;
+	std::function<void (pgm::error &error)> run;
+};
+
+// Size of the output read by the read_all benchmark.
+static constexpr std::size_t output_size = 16 * 1024 * 1024;
+
+// Runs in the forked child of the read_all benchmark. Writes output_size bytes to stdout in 64 KiB chunks.
+static void
+write_output(void *) {
+	static char chunk[64 * 1024];
+	for (std::size_t written = 0; written < output_size; written += sizeof(chunk)) {
+		for (std::size_t offset = 0; offset < sizeof(chunk);) {
+			ssize_t result = ::write(STDOUT_FILENO, chunk + offset, sizeof(chunk) - offset);
+			if (result <= 0) {
+				std::_Exit(1);
+			}
+			offset += static_cast<std::size_t>(result);
+		}
+	}
+}
+
+// A make rule like the ones the compiler writes for a unit with count headers: one prerequisite per line, some paths with escaped spaces.
+static std::string
+make_rule(std::size_t count) {
+	std::string rule = ": src/main.cpp";
+	for (std::size_t i = 0; i < count; i++) {
+		rule += i % 10 == 0
+			? std::format(" \\\n include/with\\ space/header_{:04}.hpp", i)
+			: std::format(" \\\n /usr/include/c++/12/bits/header_{:04}.h", i);
+	}
+	rule += "\n";
+	return rule;
+}
+
+int main(int argc, char *argv[]) {
+	pgm::error error;
+	std::vector<std::string> filters(argv + 1, argv + argc);
+
+	// Files stat'ed by the last_write_time and manifest::stat benchmarks.
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / std::format("cromple-micro-{}", ::getpid());
+	std::vector<std::filesystem::path> files;
+	std::vector<std::string> file_strings;
+	std::filesystem::create_directories(directory);
+	for (std::size_t i = 0; i < 1000; i++) {
+		files.push_back(directory / std::format("file_{:04}.hpp", i));
+		file_strings.push_back(files.back().string());
+		std::ofstream(files.back()) << "#pragma once\n";
+	}
+
+	const std::string rule = make_rule(2000);
+
+	std::vector<benchmark> benchmarks = {
+		{"process::exec", 200, 1, [](pgm::error &error) {
+			pgm::process::child child = pgm::process::exec({"/bin/true"}, error);
+			if (error) {
+				return;
+			}
+			child.wait(error);
+			child.close(error);
+		}},
+		// Includes forking the writer, which process::exec times on its own.
+		{"read_all 16 MiB", 20, 1, [](pgm::error &error) {
+			pgm::process::child child = pgm::process::fork<void *>(write_output, nullptr, error);
+			if (error) {
+				return;
+			}
+			std::string output = child.read_all_stdout_string(error);
+			child.wait(error);
+			child.close(error);
+			if (!error && output.size() != output_size) {
+				error.append(std::format("Read {} bytes instead of {}.", output.size(), output_size));
+			}
+		}},
+		{"parse_make_prerequisites 2000", 200, 1, [&rule](pgm::error &error) {
+			std::vector<std::string> prerequisites = pgm::compiler::parse_make_prerequisites(rule);
+			if (prerequisites.size() != 2001) {
+				error.append(std::format("Parsed {} prerequisites instead of 2001.", prerequisites.size()));
+			}
+		}},
+		{"last_write_time", 20, files.size(), [&files](pgm::error &error) {
+			for (const std::filesystem::path &file : files) {
+				std::error_code error_code;
+				static_cast<void>(std::filesystem::last_write_time(file, error_code));
+				if (error_code) {
+					error.append(std::format("Error getting modification time of \"{}\": {}.", file.string(), error_code.message()));
+					return;
+				}
+			}
+		}},
+		{"manifest::stat", 20, files.size(), [&file_strings](pgm::error &error) {
+			for (const std::string &file : file_strings) {
+				if (pgm::manifest::stat(file).modified == 0) {
+					error.append(std::format("\"{}\" does not exist.", file));
+					return;
+				}
+			}
+		}},
+	};
+
+	std::cout << std::format("{:<32} {:>14} {:>12}", "benchmark", "ns/op", "allocs/op") << std::endl;
+	for (const benchmark &benchmark : benchmarks) {
+		bool selected = filters.empty();
+		for (const std::string &filter : filters) {
+			selected = selected || benchmark.name.find(filter) != std::string::npos;
+		}
+		if (!selected) {
+			continue;
+		}
+
+		// One untimed run so caches are warm and one time allocations, like the first stat of a directory, aren't counted.
+		benchmark.run(error);
+		std::size_t start_allocations = allocations;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < benchmark.iterations && !error; i++) {
+			benchmark.run(error);
+		}
+		std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		std::size_t benchmark_allocations = allocations - start_allocations;
+		if (error) {
+			error.append(std::format("Error running benchmark \"{}\".", benchmark.name));
+			break;
+		}
+
+		double operations = static_cast<double>(benchmark.iterations * benchmark.operations);
+		std::cout << std::format("{:<32} {:>14.1f} {:>12.1f}", benchmark.name, static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / operations, static_cast<double>(benchmark_allocations) / operations) << std::endl;
+	}
+
+	std::error_code error_code;
+	std::filesystem::remove_all(directory, error_code);
+	if (error) {
+		return error.print();
+	}
+	return 0;
+}
@@ -4,23 +4,41 @@
 
 echo Compiling... This will take 10s or so. This is a purposefully dumb build script.
 
-g++ \
--std=c++20 \
--Wfatal-errors -Werror \
--Wall -Wextra -Wpedantic \
--Wfloat-equal -Wsign-conversion -Wfloat-conversion \
--Wno-error=unused-but-set-parameter \
--Wno-error=unused-but-set-variable \
--Wno-error=unused-function \
--Wno-error=unused-label \
--Wno-error=unused-local-typedefs \
--Wno-error=unused-parameter \
--Wno-error=unused-result \
--Wno-error=unused-variable \
--Wno-error=unused-value \
--o bin/cromple \
-src/*.cpp
+flags=(
+-std=c++20
+-Wfatal-errors -Werror
+-Wall -Wextra -Wpedantic
+-Wfloat-equal -Wsign-conversion -Wfloat-conversion
+-Wno-error=unused-but-set-parameter
+-Wno-error=unused-but-set-variable
+-Wno-error=unused-function
+-Wno-error=unused-label
+-Wno-error=unused-local-typedefs
+-Wno-error=unused-parameter
+-Wno-error=unused-result
+-Wno-error=unused-variable
+-Wno-error=unused-value
+)
 
-status=$?
+# Everything except cromples own main is libcromple, the library that tools use to build in process through "src/project.hpp".
+# It's compiled once, position independent so the same objects make both the static and the shared library.
+library_sources=$(ls src/*.cpp | grep -v '^src/main.cpp$')
+mkdir -p bin/libcromple
+library_objects=()
+for source in $library_sources; do
+	object="bin/libcromple/$(basename "$source").o"
+	g++ "${flags[@]}" -fPIC -c "$source" -o "$object" || exit $?
+	library_objects+=("$object")
+done
+rm -f bin/libcromple.a
+ar rcs bin/libcromple.a "${library_objects[@]}" || exit $?
+g++ -shared -o bin/libcromple.so "${library_objects[@]}" || exit $?
 
-exit $status
+# cromple itself is a client of the library.
+g++ "${flags[@]}" -o bin/cromple src/main.cpp bin/libcromple.a || exit $?
+
+# Worker that compiles preprocessed translation units sent by "cromple --workers".
+g++ "${flags[@]}" -o bin/cromple-worker src/worker/*.cpp bin/libcromple.a || exit $?
+
+# Microbenchmarks of the process, parsing and stat layers. See "Benchmarks" in readme.txt.
+g++ "${flags[@]}" -I src -o bin/cromple-micro bench/micro.cpp bin/libcromple.a || exit $?
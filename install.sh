@@ -1,3 +1,3 @@
 #!/usr/bin/bash
 
-sudo cp bin/cromple /usr/local/bin
+sudo cp bin/cromple bin/cromple-worker /usr/local/bin
@@ -1,23 +1,86 @@
 #include "arguments.hpp"
 
 #include <map>
+#include <list>
+#include <format>
+#include <thread>
+#include <charconv>
+#include <string_view>
+
+// Splits comma separated values, skipping empty ones.
+static std::vector<std::string>
+split_commas(const std::string &values) {
+	std::vector<std::string> split;
+	std::string::size_type start = 0;
+	while (start < values.size()) {
+		std::string::size_type end = values.find(',', start);
+		if (end == std::string::npos) {
+			end = values.size();
+		}
+		if (end > start) {
+			split.push_back(values.substr(start, end - start));
+		}
+		start = end + 1;
+	}
+	return split;
+}
+
+// Parses text that is only a decimal number into number. Signs, spaces and numbers that don't fit are rejected.
+static bool
+parse_unsigned(std::string_view text, unsigned &number) {
+	std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), number);
+	return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
 
 pgm::arguments
-pgm::arguments::parse(int argc, char **argv) {
+pgm::arguments::parse(int argc, char **argv, error &error) {
 	pgm::arguments arguments;
 
 	// Default arguments
 	std::string source_directory("src");
-	std::string object_directory("obj");
-	std::string out_file("a.out");
+	std::string jobs(std::to_string(std::max(1u, std::thread::hardware_concurrency())));
+	std::string workers;
+	std::string worker_timeout(std::to_string(pgm::remote::default_timeout.count()));
+	std::string graph;
+	std::string profile;
+	std::string overrides;
+	std::string generators;
+	std::string shard;
+	std::string shard_costs;
+	std::string merge;
+	arguments.scanner = "compiler";
 	arguments.compiler = "/usr/bin/g++";
 
+	// Arguments that can be given per configuration.
+	// The first segment holds the arguments given before any "--config NAME" and is shared by all configurations.
+	// Each "--config NAME" starts a new segment that applies until the next "--config".
+	class segment {
+		public:
+		std::string name;
+		std::string object_directory;
+		std::string out_file;
+		std::vector<std::string> compiler_arguments;
+	};
+	// Use a list so pointers into segments stay valid as segments are added.
+	std::list<segment> segments(1);
+	segments.front().object_directory = "obj";
+	segments.front().out_file = "a.out";
+
 	std::map<std::string, std::string *> argument_pointers {
-		// {flags,     argument pointers  }
-		{"--source",   &source_directory  }, // source_directory must be provided by a named argument because we can't know which arguments belong to a previous compiler argument like "library" in "-l library". We can't accurately parse all compiler args.
-		{"--objects",  &object_directory  },
-		{"-o",         &out_file          },
-		{"--compiler", &arguments.compiler},
+		// {flags,            argument pointers  }
+		{"--source",         &source_directory  }, // source_directory must be provided by a named argument because we can't know which arguments belong to a previous compiler argument like "library" in "-l library". We can't accurately parse all compiler args.
+		{"--compiler",       &arguments.compiler},
+		{"--jobs",           &jobs              },
+		{"--workers",        &workers           },
+		{"--worker-timeout", &worker_timeout    },
+		{"--scanner",        &arguments.scanner },
+		{"--graph",          &graph             },
+		{"--profile",        &profile           },
+		{"--overrides",      &overrides         },
+		{"--generators",     &generators        },
+		{"--shard",          &shard             },
+		{"--shard-costs",    &shard_costs       },
+		{"--merge",          &merge             },
 	};
 
 	// Points to where to store the next option. When finding "--compiler" point this to compiler so it gets set in the next loop.
@@ -35,7 +98,7 @@ pgm::arguments::parse(int argc, char **argv) {
 			continue;
 		}
 
-		// Parse 
+		// Parse
 		if (arg[0] == '-') {
 			// Point argument_pointer to place to store next argument.
 			std::map<std::string, std::string *>::iterator flag_iterator = argument_pointers.find(arg);
@@ -46,6 +109,36 @@ pgm::arguments::parse(int argc, char **argv) {
 				continue;
 			}
 
+			// Per configuration key-value arguments are stored in the current (last) segment.
+			if (arg == "--objects") {
+				argument_pointer = &segments.back().object_directory;
+				continue;
+			}
+			if (arg == "-o") {
+				argument_pointer = &segments.back().out_file;
+				continue;
+			}
+			if (arg == "--config") {
+				segments.emplace_back();
+				argument_pointer = &segments.back().name;
+				continue;
+			}
+
+			if (arg == "--explain") {
+				arguments.explain = true;
+				continue;
+			}
+
+			if (arg == "--lto") {
+				arguments.lto = true;
+				continue;
+			}
+
+			if (arg == "--modules") {
+				arguments.modules = true;
+				continue;
+			}
+
 			if (arg == "--help" || arg == "-h" || arg == "-?") {
 				arguments.help = true;
 				continue;
@@ -53,14 +146,142 @@ pgm::arguments::parse(int argc, char **argv) {
 		}
 
 		// Store all other arguments to be passed directly to the compiler.
-		arguments.compiler_arguments.push_back(arg);
+		segments.back().compiler_arguments.push_back(arg);
 		continue;
 	}
 
-	// Convert string path arguments to filesystems::path.
-	arguments.source_directory = std::filesystem::path(source_directory);
-	arguments.object_directory = std::filesystem::path(object_directory);
-	arguments.out_file = std::filesystem::path(out_file);
+	do {
+		if (argument_pointer != nullptr) {
+			error.append(std::format("Missing value for argument \"{}\".", argv[argc - 1]));
+			break;
+		}
+
+		try {
+			unsigned long parsed_jobs = std::stoul(jobs);
+			if (parsed_jobs == 0) {
+				throw std::invalid_argument("zero");
+			}
+			arguments.jobs = static_cast<unsigned>(parsed_jobs);
+		} catch (const std::exception &exception) {
+			error.append(std::format("\"--jobs\" must be a positive integer but got \"{}\".", jobs));
+			break;
+		}
 
+		if (arguments.scanner != "compiler" && arguments.scanner != "native" && arguments.scanner != "verify") {
+			error.append(std::format("\"--scanner\" must be \"compiler\", \"native\" or \"verify\" but got \"{}\".", arguments.scanner));
+			break;
+		}
+
+		arguments.workers = split_commas(workers);
+
+		try {
+			unsigned long parsed_worker_timeout = std::stoul(worker_timeout);
+			if (parsed_worker_timeout == 0) {
+				throw std::invalid_argument("zero");
+			}
+			arguments.worker_timeout = std::chrono::seconds(parsed_worker_timeout);
+		} catch (const std::exception &exception) {
+			error.append(std::format("\"--worker-timeout\" must be a positive number of seconds but got \"{}\".", worker_timeout));
+			break;
+		}
+
+		if (!shard.empty()) {
+			std::string::size_type slash = shard.find('/');
+			unsigned index = 0;
+			unsigned count = 0;
+			if (slash == std::string::npos || !parse_unsigned(std::string_view(shard).substr(0, slash), index) || !parse_unsigned(std::string_view(shard).substr(slash + 1), count) || index == 0 || index > count) {
+				error.append(std::format("\"--shard\" must be \"K/N\" with 1 <= K <= N but got \"{}\".", shard));
+				break;
+			}
+			arguments.shard_index = index - 1;
+			arguments.shard_count = count;
+		}
+		for (const std::string &directory : split_commas(merge)) {
+			arguments.merge.push_back(std::filesystem::path(directory));
+		}
+		arguments.shard_costs = std::filesystem::path(shard_costs);
+		if (!arguments.shard_costs.empty() && arguments.shard_count == 0) {
+			error.append("\"--shard-costs\" only applies to \"--shard\".");
+			break;
+		}
+		if (arguments.shard_count > 0 && !arguments.merge.empty()) {
+			error.append("\"--shard\" and \"--merge\" can't be given together. Build each shard with \"--shard\", then link them with \"--merge\".");
+			break;
+		}
+		// Module interfaces must be compiled before their importers, which may be in another shard.
+		if (arguments.modules && (arguments.shard_count > 0 || !arguments.merge.empty())) {
+			error.append("\"--modules\" can't be combined with \"--shard\" or \"--merge\".");
+			break;
+		}
+
+		// Convert string path arguments to filesystems::path.
+		arguments.source_directory = std::filesystem::path(source_directory);
+		arguments.graph = std::filesystem::path(graph);
+		arguments.profile = std::filesystem::path(profile);
+		arguments.overrides = std::filesystem::path(overrides);
+		arguments.generators = std::filesystem::path(generators);
+
+		const segment &shared = segments.front();
+
+		// Without "--config" the shared arguments form a single unnamed configuration.
+		if (segments.size() == 1) {
+			arguments.configurations.push_back({"", shared.object_directory, shared.out_file, shared.compiler_arguments});
+			return arguments;
+		}
+
+		// Shared arguments apply to all named configurations.
+		// Named configurations default to a subdirectory of the shared objects directory and a suffixed output so variants never overwrite each others files.
+		for (std::list<segment>::const_iterator iterator = std::next(segments.begin()); iterator != segments.end(); ++iterator) {
+			pgm::arguments::configuration configuration;
+			configuration.name = iterator->name;
+			if (configuration.name.empty()) {
+				error.append("Configuration names given with \"--config\" must not be empty.");
+				break;
+			}
+			for (const pgm::arguments::configuration &other : arguments.configurations) {
+				if (other.name == configuration.name) {
+					error.append(std::format("Configuration \"{}\" is given more than once.", configuration.name));
+					break;
+				}
+			}
+			if (error) {
+				break;
+			}
+			configuration.object_directory = iterator->object_directory.empty()
+				? std::filesystem::path(shared.object_directory) / configuration.name
+				: std::filesystem::path(iterator->object_directory);
+			configuration.out_file = iterator->out_file.empty()
+				? std::filesystem::path(shared.out_file + "-" + configuration.name)
+				: std::filesystem::path(iterator->out_file);
+			configuration.compiler_arguments = shared.compiler_arguments;
+			configuration.compiler_arguments.insert(configuration.compiler_arguments.end(), iterator->compiler_arguments.begin(), iterator->compiler_arguments.end());
+			arguments.configurations.push_back(std::move(configuration));
+		}
+		if (error) {
+			break;
+		}
+		// Shards only record the units they compiled so they can't tell which configuration to link.
+		if (!arguments.merge.empty()) {
+			error.append("\"--merge\" links a single configuration and can't be combined with \"--config\".");
+			break;
+		}
+
+		return arguments;
+	} while (false);
+
+	error.append("Error parsing arguments.");
 	return arguments;
 }
+
+pgm::arguments
+pgm::arguments::parse(const std::vector<std::string> &arguments, error &error) {
+	// parse only reads argv so pointing into arguments is fine.
+	std::vector<char *> argv;
+	argv.reserve(arguments.size() + 2);
+	argv.push_back(const_cast<char *>("cromple"));
+	for (const std::string &argument : arguments) {
+		argv.push_back(const_cast<char *>(argument.c_str()));
+	}
+	argv.push_back(nullptr);
+	return parse(static_cast<int>(argv.size() - 1), argv.data(), error);
+}
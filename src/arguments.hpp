@@ -1,22 +1,70 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <string>
 #include <vector>
 
+#include "error.hpp"
+#include "remote.hpp"
+
 namespace pgm {
 	class arguments {
 		public:
+		// A named set of compiler flags, objects directory and output that is built from the same source directory.
+		// Several configurations can be built in one invocation (e.g. debug, release and sanitizer variants) so the source directory is only walked and scanned once.
+		class configuration {
+			public:
+			// Empty for the unnamed configuration that is used when no "--config" argument is given.
+			std::string name;
+			std::filesystem::path object_directory;
+			std::filesystem::path out_file;
+			// Shared compiler arguments followed by the arguments given after this configurations "--config NAME".
+			std::vector<std::string> compiler_arguments;
+		};
+
 		std::filesystem::path source_directory;
-		std::filesystem::path object_directory;
-		std::filesystem::path out_file;
 		std::string compiler;
-		std::vector<std::string> compiler_arguments;
+		// Maximum number of compiler processes to run at the same time.
+		unsigned jobs = 1;
+		// "host:port" addresses of cromple-worker processes to compile on. Empty compiles locally.
+		std::vector<std::string> workers;
+		// Time allowed for connecting to a worker and for each message to or from it, including the response that waits for the compile. Slower workers are skipped.
+		std::chrono::seconds worker_timeout = pgm::remote::default_timeout;
+		// How prerequisites of units without a dependency file are found. "compiler" runs compiler -MM, "native" uses pgm::include_scanner and falls back to the compiler when unsure, "verify" runs both and reports differences.
+		std::string scanner;
+		// Always contains at least one configuration.
+		std::vector<configuration> configurations;
+		// Build C++20 modules: scan which units provide and import modules and compile interfaces before their importers.
+		bool modules = false;
+		// Path to write the dependency graph of the first configuration to, with headers ranked by rebuild cost. Empty for none.
+		std::filesystem::path graph;
+		// Path to write the compile time profile of all units to, with headers and templates ranked by the time the compiler spent on them. Empty for none.
+		std::filesystem::path profile;
+		// Path of the file with compiler options for some units, see pgm::overrides. Empty for none.
+		std::filesystem::path overrides;
+		// Path of the file with rules for generating sources, see pgm::generators. Empty for none.
+		std::filesystem::path generators;
+		// Compile only shard shard_index (counting from 0) of shard_count shards of the units ("--shard K/N"). 0 shards compiles everything.
+		unsigned shard_index = 0;
+		unsigned shard_count = 0;
+		// Manifest of an earlier build whose compile times balance the shards ("--shard-costs"). Every shard must be given the same one. Empty splits by file name.
+		std::filesystem::path shard_costs;
+		// Object directories of shards to link together instead of compiling ("--merge"). Empty for a normal build.
+		std::vector<std::filesystem::path> merge;
+		// Compile for link time optimization and link with it in parallel, caching optimized partitions in the objects directory.
+		bool lto = false;
+		// Print why each unit is recompiled and a summary of the time each reason cost.
+		bool explain = false;
 		// static bool verbose = false;
 		bool help = false;
 
 		// Parse program arguments into an instance of arguments.
 		static pgm::arguments
-		parse(int argc, char **argv);
+		parse(int argc, char **argv, error &error);
+
+		// Parses arguments given like on the command line but without the executable, e.g. {"--source", "src", "-O2"}. For tools using pgm::project.
+		static pgm::arguments
+		parse(const std::vector<std::string> &arguments, error &error);
 	};
-}
\ No newline at end of file
+}
@@ -2,71 +2,309 @@
 
 #include <iostream>
 #include <format>
+#include <algorithm>
+#include <memory>
+#include <sstream>
 
 #include "process.hpp"
+#include "remote.hpp"
+#include "diagnostic.hpp"
 
 std::vector<std::string> command_parts;
 
-pgm::compiler::compiler(std::string executable, const std::vector<std::string> &arguments) {
+pgm::compiler::compiler(std::string executable, const std::vector<std::string> &arguments, const std::vector<std::string> &workers, std::chrono::milliseconds worker_timeout) : workers{workers}, worker_timeout{worker_timeout} {
 	command_parts.reserve(arguments.size() + 1);
 	command_parts.push_back(executable);
 	command_parts.insert(command_parts.end(), arguments.begin(), arguments.end());
 }
 
 void
-pgm::compiler::compile(const pgm::translation_unit &unit, error &error) const {
-	std::vector<std::string> command = command_parts;
-	do {
-		// Build command vector for exec.
-		// Pertinent args copied directly from "gcc --help":
-		// -c                       Compile and assemble, but do not link.
-		// -o <file>                Place the output into <file>.
-		command.insert(command.end(), {"-c", unit.root_path, "-o", unit.object_path});
+pgm::compiler::set_module_mapper(const std::filesystem::path &mapper_path) {
+	// -fmodules-ts              Enable C++20 modules in GCC.
+	// -fmodule-mapper=<file>    Read module name to BMI path mappings from <file> instead of using gcm.cache in the working directory.
+	module_arguments = {"-fmodules-ts", "-fmodule-mapper=" + mapper_path.string()};
+}
+
+void
+pgm::compiler::set_profiling() {
+	// -ftime-trace     Clang: write a Chrome trace of the compile next to the object, timing every header and template instantiation.
+	// -ftime-report    GCC: print the time spent in each pass to stderr.
+	profile_arguments = {is_clang() ? "-ftime-trace" : "-ftime-report"};
+}
+
+void
+pgm::compiler::set_lto(const std::filesystem::path &cache_directory) {
+	lto_cache_directory = cache_directory;
+	if (is_clang()) {
+		// -flto=thin                       Write LLVM bitcode with a summary so partitions are optimized independently.
+		// -Wl,--thinlto-cache-dir=<dir>    lld: keep optimized partitions in <dir> and reuse the ones whose inputs didn't change.
+		lto_arguments = {"-flto=thin"};
+		lto_link_arguments = {"-flto=thin", "-Wl,--thinlto-cache-dir=" + cache_directory.string()};
+		return;
+	}
+	// -flto          Write GIMPLE into the objects.
+	// -flto=auto     Optimize partitions in parallel, as many as the make jobserver or the number of CPUs allows.
+	// -ftime-report  Every lto1 process prints the time it took, which is the link time optimization cost.
+	lto_arguments = {"-flto"};
+	lto_link_arguments = {"-flto=auto", "-ftime-report"};
+}
+
+void
+pgm::compiler::detect_lto_cache(error &error) {
+	if (lto_cache_directory.empty() || is_clang()) {
+		return;
+	}
+	std::string cache_argument = "-flto-incremental=" + lto_cache_directory.string();
+	if (supports_option(cache_argument, error)) {
+		lto_link_arguments.push_back(cache_argument);
+	}
+}
 
-		// Run command.
+void
+pgm::compiler::set_overrides(const pgm::overrides &overrides) {
+	this->overrides = overrides;
+}
+
+std::vector<std::string>
+pgm::compiler::unit_command_parts(const std::filesystem::path &source) const {
+	std::vector<std::string> parts = command_parts;
+	std::vector<std::string> unit_arguments = overrides.arguments(source);
+	parts.insert(parts.end(), unit_arguments.begin(), unit_arguments.end());
+	return parts;
+}
+
+void
+pgm::compiler::detect_diagnostics_format(error &error) {
+	for (const std::string &part : command_parts) {
+		if (part.starts_with("-fdiagnostics-format=")) {
+			return;
+		}
+	}
+	if (supports_option("-fdiagnostics-format=json", error)) {
+		diagnostic_arguments = {"-fdiagnostics-format=json"};
+	}
+}
+
+bool
+pgm::compiler::supports_option(const std::string &argument, error &error) const {
+	do {
+		// Preprocess an empty file. Unknown options are an error even then.
+		std::vector<std::string> command = {command_parts[0], argument, "-x", "c++", "-E", "/dev/null", "-o", "/dev/null"};
 		process::child child = process::exec(command, error);
 		if (error) {
 			break;
 		}
+		child.read_all_stderr_string(error);
 		int exit_status = child.wait(error);
+		child.close(error);
 		if (error) {
 			break;
 		}
+		return exit_status == 0;
+	} while (false);
 
-		// Check exit status
+	error.append(std::format("Error checking if compiler \"{}\" supports \"{}\".", command_parts[0], argument));
+	return false;
+}
+
+std::vector<std::string>
+pgm::compiler::system_include_directories(error &error) const {
+	std::vector<std::string> directories;
+	for (const char *language : {"c", "c++"}) {
+		// -v prints the search list to stderr between these lines, one directory per line indented by a space.
+		// Without the compiler arguments, because their -I and unknown include options would be listed too and taken for system directories.
+		std::vector<std::string> command = {command_parts[0], "-x", language, "-E", "-v", "/dev/null", "-o", "/dev/null"};
+		process::child child = process::exec(command, error);
+		if (error) {
+			break;
+		}
+		std::string output = child.read_all_stderr_string(error);
+		int exit_status = child.wait(error);
+		child.close(error);
+		if (error) {
+			break;
+		}
 		if (exit_status != 0) {
 			error
-				.append(child.read_all_stderr_string(error))
-				.append(std::format("Exit status {}.", exit_status))
+				.append(output)
+				.append(std::format("Exit status {} from listing the include directories of \"{}\".", exit_status, command_parts[0]))
 			;
 			break;
 		}
 
-		return;
-	} while (false);
+		std::istringstream lines(output);
+		std::string line;
+		bool listing = false;
+		while (std::getline(lines, line)) {
+			if (line.starts_with("#include <...> search starts here:")) {
+				listing = true;
+			} else if (line.starts_with("End of search list.")) {
+				break;
+			} else if (listing && line.starts_with(" ")) {
+				std::string directory = line.substr(1);
+				// Clang on macOS marks framework directories. Headers in them are still system headers.
+				static const std::string framework = " (framework directory)";
+				if (directory.ends_with(framework)) {
+					directory.erase(directory.size() - framework.size());
+				}
+				if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+					directories.push_back(directory);
+				}
+			}
+		}
+	}
+	if (error) {
+		error.append(std::format("Error listing the system include directories of compiler \"{}\".", command_parts[0]));
+	}
+	return directories;
+}
+
+bool
+pgm::compiler::is_clang() const {
+	return std::filesystem::path(command_parts[0]).filename().string().find("clang") != std::string::npos;
+}
+
+std::vector<std::string>
+pgm::compiler::module_scan_command(const pgm::translation_unit &unit, const std::filesystem::path &scan_path, const std::filesystem::path &scan_dependency_path) const {
+	std::vector<std::string> command = unit_command_parts(unit.root_path);
+	// -E                          Only preprocess. Scanning must not need BMIs that haven't been built yet.
+	// -fdeps-format=p1689r5       Write module dependencies as P1689 JSON...
+	// -fdeps-file=<file>          ...to <file>...
+	// -fdeps-target=<file>        ...for the object <file>.
+	// -MMD -MF <file> -MT ""      Also write the headers that were read so the scan is only repeated when one of them changes.
+	command.insert(command.end(), {"-fmodules-ts", "-E", unit.root_path, "-o", "/dev/null", "-fdeps-format=p1689r5", "-fdeps-file=" + scan_path.string(), "-fdeps-target=" + unit.object_path.string(), "-MMD", "-MF", scan_dependency_path, "-MT", ""});
+	return command;
+}
+
+std::vector<std::string>
+pgm::compiler::compile_command(const pgm::translation_unit &unit) const {
+	std::vector<std::string> command = unit_command_parts(unit.root_path);
+	command.insert(command.end(), module_arguments.begin(), module_arguments.end());
+	command.insert(command.end(), lto_arguments.begin(), lto_arguments.end());
+	// Pertinent args copied directly from "gcc --help":
+	// -c                       Compile and assemble, but do not link.
+	// -o <file>                Place the output into <file>.
+	// -MMD -MF <file>          Also write the make rule of user headers to <file>. Used to check the unit later without running -MM.
+	// -MT ""                   Leave out the target like get_make_prerequisites does so the same parser works.
+	command.insert(command.end(), {"-c", unit.root_path, "-o", unit.object_path, "-MMD", "-MF", unit.dependency_path, "-MT", ""});
+	return command;
+}
+
+pgm::job_pool::job
+pgm::compiler::compile_job(const pgm::translation_unit &unit) const {
+	std::vector<std::string> command = compile_command(unit);
+	command.insert(command.end(), profile_arguments.begin(), profile_arguments.end());
+	command.insert(command.end(), diagnostic_arguments.begin(), diagnostic_arguments.end());
 
 	// Build command string for error.
 	std::string command_string;
 	for (const std::string &part : command) {
 		command_string += " " + part;
 	}
-	error.append(std::format("Error compiling source file \"{}\" to object file \"{}\" with command \"{}\".", unit.root_path.string(), unit.object_path.string(), command_string));
+
+	pgm::job_pool::job job;
+	job.description = std::format("Error compiling source file \"{}\" to object file \"{}\" with command \"{}\".", unit.root_path.string(), unit.object_path.string(), command_string);
+	if (!diagnostic_arguments.empty()) {
+		job.format_stderr = pgm::diagnostic::render_output;
+	}
+
+	// Preprocessing is done locally so the worker only gets the options that matter for compiling preprocessed source.
+	// Diagnostic arguments are left out because only the local compiler was checked for them and a worker running another compiler would fail every unit.
+	// Workers write text diagnostics, which render_output passes through and diagnostic::parse reads too.
+	std::vector<std::string> parts = unit_command_parts(unit.root_path);
+	std::vector<std::string> request_arguments = pgm::remote::request_arguments(std::vector<std::string>(parts.begin() + 1, parts.end()));
+	request_arguments.insert(request_arguments.end(), lto_arguments.begin(), lto_arguments.end());
+
+	// Workers refuse options that could run programs or touch files, so units that need them are compiled locally.
+	if (workers.empty() || !module_arguments.empty() || !profile_arguments.empty() || !pgm::remote::rejected_argument(request_arguments).empty()) {
+		job.start = [command](error &error) {
+			return process::exec(command, error);
+		};
+		return job;
+	}
+
+	// Shared so the job stays alive until the forked child has its own copy.
+	std::shared_ptr<pgm::remote::job> remote_job = std::make_shared<pgm::remote::job>();
+	// Rotate the worker list so consecutive compiles start on different workers.
+	for (std::vector<std::string>::size_type i = 0; i < workers.size(); i++) {
+		remote_job->workers.push_back(workers[(next_worker + i) % workers.size()]);
+	}
+	next_worker = (next_worker + 1) % workers.size();
+	remote_job->preprocessed_path = unit.object_path;
+	remote_job->preprocessed_path += ".i";
+	remote_job->preprocess_command = parts;
+	remote_job->preprocess_command.insert(remote_job->preprocess_command.end(), {"-E", unit.root_path, "-o", remote_job->preprocessed_path, "-MMD", "-MF", unit.dependency_path, "-MT", ""});
+	remote_job->preprocess_command.insert(remote_job->preprocess_command.end(), diagnostic_arguments.begin(), diagnostic_arguments.end());
+	remote_job->request.language = pgm::remote::preprocessed_language(parts, unit.root_path);
+	remote_job->request.arguments = request_arguments;
+	remote_job->object_path = unit.object_path;
+	remote_job->local_command = command;
+	remote_job->timeout = worker_timeout;
+	job.start = [remote_job](error &error) {
+		return process::fork<void *>(pgm::remote::run, remote_job.get(), error);
+	};
+	return job;
+}
+
+std::uint64_t
+pgm::compiler::fingerprint(const pgm::translation_unit &unit) const {
+	return hash(compile_command(unit));
+}
+
+std::uint64_t
+pgm::compiler::fingerprint(const std::filesystem::path &out_file) const {
+	std::vector<std::string> parts = command_parts;
+	parts.insert(parts.end(), module_arguments.begin(), module_arguments.end());
+	parts.insert(parts.end(), lto_arguments.begin(), lto_arguments.end());
+	// Rules are hashed rather than the file so comments can change without checking every unit.
+	// Each rule starts with an empty part, which no option can be, so the same options split into rules differently hash differently.
+	for (const pgm::overrides::rule &rule : overrides.rules) {
+		parts.push_back("");
+		parts.push_back(rule.glob);
+		parts.insert(parts.end(), rule.arguments.begin(), rule.arguments.end());
+	}
+	parts.push_back(out_file);
+	return hash(parts);
+}
+
+std::uint64_t
+pgm::compiler::hash(const std::vector<std::string> &parts) {
+	std::uint64_t hash = 0xcbf29ce484222325;
+	for (const std::string &part : parts) {
+		for (char c : part) {
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 0x100000001b3;
+		}
+		// Separator.
+		hash ^= 0xff;
+		hash *= 0x100000001b3;
+	}
+	return hash;
 }
 
 void
-pgm::compiler::link(const std::vector<translation_unit> &units, std::string out_file, error &error) {
+pgm::compiler::link(const std::vector<translation_unit> &units, std::string out_file, error &error, lto_report *report) const {
 	std::vector<std::string> command = command_parts;
 	do {
+		command.insert(command.end(), lto_link_arguments.begin(), lto_link_arguments.end());
 		command.insert(command.end(), {"-o", out_file});
 		for (const translation_unit &unit : units) {
 			command.push_back(unit.object_path);
 		}
 
+		if (!lto_link_arguments.empty()) {
+			std::error_code error_code;
+			std::filesystem::create_directories(lto_cache_directory, error_code);
+		}
+
 		process::child child = process::exec(command, error);
 		if (error) {
 			break;
 		}
+		// Read stderr before waiting. The time reports of many partitions don't fit in a pipe so the linker would block forever.
+		std::string stderr_output = child.read_all_stderr_string(error);
 		int exit_status = child.wait(error);
+		child.close(error);
 		if (error) {
 			break;
 		}
@@ -74,12 +312,32 @@ pgm::compiler::link(const std::vector<translation_unit> &units, std::string out_
 		// Check exit status
 		if (exit_status != 0) {
 			error
-				.append(child.read_all_stderr_string(error))
+				.append(stderr_output)
 				.append(std::format("Exit status {}.", exit_status))
 			;
 			break;
 		}
 
+		if (report != nullptr) {
+			*report = lto_report();
+			// Each lto1 process ends its table with a line like:
+			//  TOTAL                              :   0.01          0.00          0.03         2419k
+			// The columns are user, system and wall seconds, then memory.
+			std::istringstream lines(stderr_output);
+			std::string line;
+			while (std::getline(lines, line)) {
+				std::istringstream columns(line);
+				std::string name;
+				std::string colon;
+				double user = 0;
+				double system = 0;
+				double wall = 0;
+				if (columns >> name >> colon >> user >> system >> wall && name == "TOTAL" && colon == ":") {
+					report->time += std::chrono::nanoseconds(static_cast<std::int64_t>(wall * 1e9));
+					report->processes++;
+				}
+			}
+		}
 		return;
 	} while (false);
 
@@ -96,12 +354,22 @@ pgm::compiler::get_make_prerequisites(const std::string &file, error &error) con
 	do {
 		// Run compiler with -MM to output a makefile rule.
 		// Use -MT "" to remove the target at the start for simpler parsing.
-		std::vector<std::string> command = command_parts;
+		// Overrides are included because their defines can change what is included.
+		std::vector<std::string> command = unit_command_parts(file);
 		command.insert(command.end(), {file, "-MM", "-MT", ""});
 
 		// Run command
 		process::child child = process::exec(command, error);
+		if (error) {
+			break;
+		}
+
+		// Read make rule from stdout before waiting. Rules of units with many headers don't fit in a pipe so the child would block forever.
+		// Rule with escaped newlines and maybe other stuff.
+		std::string escaped_rule = child.read_all_stdout_string(error);
+		std::string diagnostics = child.read_all_stderr_string(error);
 		int exit_status = child.wait(error);
+		child.close(error);
 		if (error) {
 			break;
 		}
@@ -113,80 +381,91 @@ pgm::compiler::get_make_prerequisites(const std::string &file, error &error) con
 				command_string += " " + part;
 			}
 			error
-				.append(child.read_all_stderr_string(error))
+				.append(diagnostics)
 				.append(std::format("Exit status {} from command \"{}\".", exit_status, command_string))
 			;
 			break;
 		}
 
-		// Read make rule from stdout.
-		// Rule with escaped newlines and maybe other stuff.
-		std::string escaped_rule = child.read_all_stdout_string(error);
-		if (error) {
-			break;
-		}
+		return parse_make_prerequisites(escaped_rule);
+	} while (false);
 
-		// Parse prerequisites from make rule.
-		std::vector<std::string> prerequisites;
-		std::string prerequisite;
-		bool escaping = false;
-		bool delimiting = true;
-		constexpr char delimiter = ' ';
-		constexpr char escape = '\\'; // Used to escape newlines and delimiters in the middle of prerequisites.
-		for (std::string::iterator iterator = escaped_rule.begin() + 1 /* +1 to skip leading colon */; iterator != escaped_rule.end(); ++iterator) {
-			char c = *iterator;
+	error.append(std::format("Error getting make prerequisites for file \"{}\".", file));
+	return std::vector<std::string>();
+}
 
+std::vector<std::string>
+pgm::compiler::parse_make_prerequisites(const std::string &escaped_rule) {
+	std::vector<std::string> prerequisites;
+	if (escaped_rule.empty()) {
+		return prerequisites;
+	}
+
+	// Skip the target. It ends at the first colon that is followed by whitespace or the end of the rule.
+	// Usually the rule starts with that colon because the target is left out with -MT "", but GCC names the BMI as target for module interfaces.
+	std::string::size_type colon = 0;
+	while (colon < escaped_rule.size() && !(escaped_rule[colon] == ':' && (colon + 1 == escaped_rule.size() || escaped_rule[colon + 1] == ' ' || escaped_rule[colon + 1] == '\n'))) {
+		colon++;
+	}
+	if (colon == escaped_rule.size()) {
+		return prerequisites;
+	}
+
+	std::string prerequisite;
+	bool escaping = false;
+	bool delimiting = true;
+	constexpr char delimiter = ' ';
+	constexpr char escape = '\\'; // Used to escape newlines and delimiters in the middle of prerequisites.
+	for (std::string::const_iterator iterator = escaped_rule.begin() + static_cast<std::string::difference_type>(colon) + 1 /* +1 to skip the colon */; iterator != escaped_rule.end(); ++iterator) {
+		char c = *iterator;
+
+		if (c == escape) {
+			escaping = true;
+			continue;
+		}
+
+		if (escaping) {
+			escaping = false;
+			// Keep escaped escape characters "\\".
 			if (c == escape) {
-				escaping = true;
+				prerequisite += c;
 				continue;
 			}
-
-			if (escaping) {
-				escaping = false;
-				// Keep escaped escape characters "\\".
-				if (c == escape) {
-					prerequisite += c;
-					continue;
-				}
-				// Keep escaped delimiters in the prerequisite.
-				if (c == delimiter) {
-					prerequisite += c;
-					continue;
-				}
-				// Ignore escaped newlines and any else that is escaped.
+			// Keep escaped delimiters in the prerequisite.
+			if (c == delimiter) {
+				prerequisite += c;
 				continue;
 			}
+			// Ignore escaped newlines and any else that is escaped.
+			continue;
+		}
+
+		// Push prerequisiste once reached end of line.
+		// Prerequisites are terminated with an unescaped newline.
+		if (c == '\n') {
+			prerequisites.push_back(prerequisite);
+			prerequisite = std::string();
+			break;
+		}
 
-			// Push prerequisiste once reached end of line.
-			// Prerequisites are terminated with an unescaped newline.
-			if (c == '\n') {
+		// Store prerequisite when we hit a delimiter, but not on multiple delimiters in a row.
+		if (c == delimiter) {
+			if (!delimiting) {
 				prerequisites.push_back(prerequisite);
 				prerequisite = std::string();
-				break;
-			}
-
-			// Store prerequisite when we hit a delimiter, but not on multiple delimiters in a row.
-			if (c == delimiter) {
-				if (!delimiting) {
-					prerequisites.push_back(prerequisite);
-					prerequisite = std::string();
-					delimiting = true;
-				}
-				continue;
+				delimiting = true;
 			}
-			delimiting = false;
-
-			prerequisite += c;
+			continue;
 		}
+		delimiting = false;
 
-		// Push the last prerequisite that was not pushed yet because no delimiter at end.
-		if (prerequisite.size() > 0) {
-			prerequisites.push_back(prerequisite);
-		}
-		
-		return prerequisites;
-	} while (false);
+		prerequisite += c;
+	}
 
-	error.append(std::format("Error getting make prerequisites for file \"{}\".", file));
-	return std::vector<std::string>();
+	// Push the last prerequisite that was not pushed yet because no delimiter at end.
+	if (prerequisite.size() > 0) {
+		prerequisites.push_back(prerequisite);
+	}
+
+	return prerequisites;
 }
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <filesystem>
 
 #include "error.hpp"
+#include "job_pool.hpp"
+#include "remote.hpp"
+#include "overrides.hpp"
 #include "translation_unit.hpp"
 
 
@@ -13,20 +19,124 @@ namespace pgm {
 	class compiler {
 		// Vector of compiler and arguments to run the compiler.
 		std::vector<std::string> command_parts;
-		
+		// "host:port" addresses of cromple-worker processes. Compiles are spread over them round robin.
+		std::vector<std::string> workers;
+		// Index into workers of the worker to try first for the next compile job.
+		mutable std::vector<std::string>::size_type next_worker = 0;
+		// Time allowed for connecting to a worker and for each message to or from it. See remote::job::timeout.
+		std::chrono::milliseconds worker_timeout;
+		// Arguments added to compiles when building with modules. Empty otherwise.
+		std::vector<std::string> module_arguments;
+		// Arguments added to compiles when profiling. Empty otherwise.
+		// They don't change the object so unlike module_arguments they are not part of any fingerprint and turning profiling on or off doesn't rebuild anything.
+		std::vector<std::string> profile_arguments;
+		// Arguments that make the compiler write diagnostics in a format pgm::diagnostic reads exactly. Empty when it only writes text. Not part of any fingerprint either.
+		std::vector<std::string> diagnostic_arguments;
+		// Arguments added to compiles with link time optimization, so objects hold the compilers intermediate representation. Part of the fingerprints like module_arguments.
+		std::vector<std::string> lto_arguments;
+		// Arguments added to links with link time optimization: parallel optimization and, where supported, the cache of optimized partitions.
+		std::vector<std::string> lto_link_arguments;
+		// Where optimized partitions are cached between links. Empty without link time optimization.
+		std::filesystem::path lto_cache_directory;
+		// Options added to the compiles of some units. Unlike profile and diagnostic arguments they change the object so they are part of the fingerprints.
+		pgm::overrides overrides;
+
+		// True if the compiler accepts argument. Runs it once on an empty file.
+		bool
+		supports_option(const std::string &argument, error &error) const;
+
+		// command_parts followed by the overrides of the unit with source.
+		std::vector<std::string>
+		unit_command_parts(const std::filesystem::path &source) const;
+
 		public:
-		compiler(std::string executable, const std::vector<std::string> &arguments);
+		compiler(std::string executable, const std::vector<std::string> &arguments, const std::vector<std::string> &workers = {}, std::chrono::milliseconds worker_timeout = pgm::remote::default_timeout);
+
+		// Compiles with C++20 modules, finding and writing BMIs (compiled module interfaces) through the module mapper file at mapper_path.
+		// Workers are not used for modules because preprocessing can't resolve imports.
+		void
+		set_module_mapper(const std::filesystem::path &mapper_path);
+
+		// Profiles every compile. Clang writes a trace next to the object with "-ftime-trace" and GCC prints a table of its passes to stderr with "-ftime-report".
+		// Workers are not used while profiling so the reports are written locally.
+		void
+		set_profiling();
+
+		// Compiles objects for link time optimization and links them with it, optimizing partitions in parallel and caching them in cache_directory so a link after a small change only optimizes the partitions that changed.
+		// Clang uses ThinLTO with "--thinlto-cache-dir", which needs lld ("-fuse-ld=lld"). GCC uses "-flto=auto" and, with detect_lto_cache, "-flto-incremental".
+		void
+		set_lto(const std::filesystem::path &cache_directory);
+
+		// Makes links cache partitions with "-flto-incremental" if GCC supports it (GCC 15 and later). Runs the compiler once to find out. Does nothing without set_lto or with clang.
+		void
+		detect_lto_cache(error &error);
+
+		// Adds the options of matching rules of overrides to the compiles of units. Workers are still used.
+		void
+		set_overrides(const pgm::overrides &overrides);
 
-		// Compiles source at unit.root_path to unit.object_path.
+		// Makes compiles write diagnostics as JSON if the compiler supports "-fdiagnostics-format=json" and no diagnostics format was given.
+		// Runs the compiler once to find out. GCC supports it, clang and GCC 15 and later don't. Those are read from their text output instead.
 		void
-		compile(const pgm::translation_unit &unit, error &error) const;
+		detect_diagnostics_format(error &error);
+
+		// True if the executable is clang, judging by its name. Only clang understands "-ftime-trace".
+		bool
+		is_clang() const;
+
+		// Command that writes the P1689 module dependencies of unit to scan_path and the headers that were read to the make rule at scan_dependency_path, without compiling.
+		std::vector<std::string>
+		module_scan_command(const pgm::translation_unit &unit, const std::filesystem::path &scan_path, const std::filesystem::path &scan_dependency_path) const;
+
+		// Command that compiles source at unit.root_path to unit.object_path, without profile arguments.
+		std::vector<std::string>
+		compile_command(const pgm::translation_unit &unit) const;
+
+		// Job that compiles source at unit.root_path to unit.object_path when run in a job_pool.
+		// With workers the source is preprocessed locally and compiled on a worker, falling back to a local compile when no worker is reachable.
+		// Units with options that workers refuse (see remote::rejected_argument) are compiled locally.
+		pgm::job_pool::job
+		compile_job(const pgm::translation_unit &unit) const;
+
+		// Time a link spent on link time optimization.
+		class lto_report {
+			public:
+			// Summed over the compiler processes that optimized, which run in parallel, so it can be longer than the link.
+			std::chrono::nanoseconds time{};
+			std::size_t processes = 0;
+		};
 
 		// Links objects at all object_paths in units to an output binary at out_file.
+		// With set_lto and GCC the link time optimization is timed with "-ftime-report" and the time is stored in report if given. Clang doesn't report it.
 		void
-		link(const std::vector<pgm::translation_unit> &units, std::string out_file, error &error);
+		link(const std::vector<pgm::translation_unit> &units, std::string out_file, error &error, lto_report *report = nullptr) const;
+
+		// Directories the compiler searches for <name> on its own, like "/usr/include", for both C and C++. -MM leaves headers found there out.
+		// Runs the compiler with "-v" once per language, without the arguments so only its built in directories are listed.
+		std::vector<std::string>
+		system_include_directories(error &error) const;
 
 		// Get the make rule prerequisites generated from compiler -MM option.
 		std::vector<std::string>
 		get_make_prerequisites(const std::string &file, error &error) const;
+
+		// Parses the prerequisites of the first make rule in escaped_rule, like the ones from -MM -MT "" or the dependency files written during compile.
+		// The target is skipped. It's empty except for module interfaces where the compiler names the BMI.
+		static
+		std::vector<std::string>
+		parse_make_prerequisites(const std::string &escaped_rule);
+
+		// 64 bit FNV-1a hash of parts. Parts are separated so {"ab", "c"} and {"a", "bc"} differ.
+		// Used for every hash cromple records so they can't drift apart.
+		static std::uint64_t
+		hash(const std::vector<std::string> &parts);
+
+		// Hash of everything that affects the object compiled from unit. Recorded in the manifest so changed flags cause a rebuild.
+		std::uint64_t
+		fingerprint(const pgm::translation_unit &unit) const;
+
+		// Hash of everything that affects any output of this compiler: executable, arguments, module and LTO arguments, overrides and out_file.
+		std::uint64_t
+		fingerprint(const std::filesystem::path &out_file) const;
 	};
 }
@@ -0,0 +1,242 @@
+#include "diagnostic.hpp"
+
+#include <array>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#include "json.hpp"
+#include "manifest.hpp"
+
+// Reads a diagnostic in GCC's JSON format. Stored diagnostics use the same format so both are read by this.
+static pgm::diagnostic
+from_json(const pgm::json &value) {
+	pgm::diagnostic diagnostic;
+	auto string = [&value](std::string_view key) {
+		const pgm::json *member = value.find(key);
+		return member != nullptr && member->kind == pgm::json::kind::string ? member->string : std::string();
+	};
+	diagnostic.kind = string("kind");
+	diagnostic.message = string("message");
+	diagnostic.option = string("option");
+
+	// The caret of the first location is where the compiler points at.
+	const pgm::json *locations = value.find("locations");
+	if (locations != nullptr && !locations->elements.empty()) {
+		const pgm::json *caret = locations->elements[0].find("caret");
+		if (caret != nullptr) {
+			const pgm::json *file = caret->find("file");
+			const pgm::json *line = caret->find("line");
+			const pgm::json *column = caret->find("column");
+			diagnostic.file = file != nullptr ? file->string : std::string();
+			// Locations on the command line have line 0 and column -1.
+			diagnostic.line = line != nullptr && line->number > 0 ? static_cast<unsigned>(line->number) : 0;
+			diagnostic.column = column != nullptr && column->number > 0 ? static_cast<unsigned>(column->number) : 0;
+		}
+	}
+
+	const pgm::json *children = value.find("children");
+	if (children != nullptr) {
+		for (const pgm::json &child : children->elements) {
+			diagnostic.children.push_back(from_json(child));
+		}
+	}
+	return diagnostic;
+}
+
+static void
+write_json(std::ostream &stream, const pgm::diagnostic &diagnostic) {
+	stream << "{\"kind\": " << pgm::json::quote(diagnostic.kind) << ", \"message\": " << pgm::json::quote(diagnostic.message);
+	if (!diagnostic.option.empty()) {
+		stream << ", \"option\": " << pgm::json::quote(diagnostic.option);
+	}
+	if (!diagnostic.file.empty()) {
+		stream << ", \"locations\": [{\"caret\": {\"file\": " << pgm::json::quote(diagnostic.file) << ", \"line\": " << diagnostic.line << ", \"column\": " << diagnostic.column << "}}]";
+	}
+	stream << ", \"children\": [";
+	for (std::vector<pgm::diagnostic>::size_type i = 0; i < diagnostic.children.size(); i++) {
+		stream << (i == 0 ? "" : ", ");
+		write_json(stream, diagnostic.children[i]);
+	}
+	stream << "]}";
+}
+
+// Parses a line like "file:line:column: kind: message [option]". Returns false if line is not a diagnostic.
+static bool
+parse_text_line(std::string_view line, pgm::diagnostic &diagnostic) {
+	// The kind is found by its surrounding ": ". Take the earliest so a message quoting ": note: " is not split there.
+	static constexpr std::array<std::string_view, 4> kinds = {"fatal error", "error", "warning", "note"};
+	std::string_view::size_type position = std::string_view::npos;
+	std::string_view kind;
+	for (std::string_view candidate : kinds) {
+		std::string_view::size_type found = line.find(std::format(": {}: ", candidate));
+		if (found < position) {
+			position = found;
+			kind = candidate;
+		}
+	}
+	if (position == std::string_view::npos) {
+		return false;
+	}
+	diagnostic.kind = std::string(kind);
+	diagnostic.message = std::string(line.substr(position + kind.size() + 4));
+
+	// Up to two trailing ":NUMBER" of the location are the column and line, or just the line.
+	std::string_view location = line.substr(0, position);
+	std::vector<unsigned> numbers;
+	while (numbers.size() < 2) {
+		std::string_view::size_type colon = location.rfind(':');
+		if (colon == std::string_view::npos || colon + 1 == location.size() || location.substr(colon + 1).find_first_not_of("0123456789") != std::string_view::npos) {
+			break;
+		}
+		numbers.insert(numbers.begin(), static_cast<unsigned>(std::strtoul(std::string(location.substr(colon + 1)).c_str(), nullptr, 10)));
+		location = location.substr(0, colon);
+	}
+	diagnostic.file = std::string(location);
+	diagnostic.line = numbers.size() > 0 ? numbers[0] : 0;
+	diagnostic.column = numbers.size() > 1 ? numbers[1] : 0;
+
+	// "message [-Wsome-option]"
+	std::string::size_type option = diagnostic.message.rfind(" [-");
+	if (option != std::string::npos && diagnostic.message.back() == ']') {
+		diagnostic.option = diagnostic.message.substr(option + 2, diagnostic.message.size() - option - 3);
+		diagnostic.message.resize(option);
+	}
+	return true;
+}
+
+// Calls callback with each line of text, without its newline.
+template <typename callback_type>
+static void
+for_each_line(std::string_view text, callback_type callback) {
+	std::string_view::size_type start = 0;
+	while (start < text.size()) {
+		std::string_view::size_type end = text.find('\n', start);
+		if (end == std::string_view::npos) {
+			end = text.size();
+		}
+		callback(text.substr(start, end - start));
+		start = end + 1;
+	}
+}
+
+// Diagnostics of a JSON line or false if line isn't one. GCC writes all diagnostics of a compile as one array on one line.
+static bool
+parse_json_line(std::string_view line, std::vector<pgm::diagnostic> &diagnostics) {
+	if (line.empty() || line[0] != '[') {
+		return false;
+	}
+	pgm::error error;
+	pgm::json array = pgm::json::parse(line, error);
+	if (error || array.kind != pgm::json::kind::array) {
+		return false;
+	}
+	for (const pgm::json &element : array.elements) {
+		diagnostics.push_back(from_json(element));
+	}
+	return true;
+}
+
+std::string
+pgm::diagnostic::render() const {
+	std::string location = file;
+	if (line != 0) {
+		location += std::format(":{}", line);
+	}
+	if (column != 0) {
+		location += std::format(":{}", column);
+	}
+	std::string text = std::format("{}{}: {}{}\n", location.empty() ? "" : location + ": ", kind, message, option.empty() ? "" : " [" + option + "]");
+	for (const diagnostic &child : children) {
+		text += child.render();
+	}
+	return text;
+}
+
+std::vector<pgm::diagnostic>
+pgm::diagnostic::parse(std::string_view output) {
+	std::vector<diagnostic> diagnostics;
+	for_each_line(output, [&diagnostics](std::string_view line) {
+		if (parse_json_line(line, diagnostics)) {
+			return;
+		}
+		diagnostic diagnostic;
+		if (!parse_text_line(line, diagnostic)) {
+			return;
+		}
+		if (diagnostic.kind == "note" && !diagnostics.empty()) {
+			diagnostics.back().children.push_back(std::move(diagnostic));
+			return;
+		}
+		diagnostics.push_back(std::move(diagnostic));
+	});
+	return diagnostics;
+}
+
+std::string
+pgm::diagnostic::render_output(std::string_view output) {
+	std::string text;
+	for_each_line(output, [&text](std::string_view line) {
+		std::vector<diagnostic> diagnostics;
+		if (!parse_json_line(line, diagnostics)) {
+			text.append(line).append("\n");
+			return;
+		}
+		for (const diagnostic &diagnostic : diagnostics) {
+			text += diagnostic.render();
+		}
+	});
+	return text;
+}
+
+std::filesystem::path
+pgm::diagnostic::path(const std::filesystem::path &object_path) {
+	std::filesystem::path path = object_path;
+	path += ".diagnostics";
+	return path;
+}
+
+void
+pgm::diagnostic::save(const std::filesystem::path &object_path, const std::vector<diagnostic> &diagnostics, error &error) {
+	std::filesystem::path path = diagnostic::path(object_path);
+	if (diagnostics.empty()) {
+		std::error_code error_code;
+		std::filesystem::remove(path, error_code);
+		if (error_code) {
+			error.append(error_code.message()).append(std::format("Error removing diagnostics file \"{}\".", path.string()));
+		}
+		return;
+	}
+
+	// One JSON array on one line, exactly like GCC writes them, so parse reads it back.
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << "[";
+	for (std::vector<diagnostic>::size_type i = 0; i < diagnostics.size(); i++) {
+		file << (i == 0 ? "" : ", ");
+		write_json(file, diagnostics[i]);
+	}
+	file << "]\n";
+	file.close();
+	if (!file) {
+		error.append(std::format("Error writing diagnostics file \"{}\".", path.string()));
+	}
+}
+
+std::vector<pgm::diagnostic>
+pgm::diagnostic::load(const std::filesystem::path &object_path, error &error) {
+	std::filesystem::path path = diagnostic::path(object_path);
+	pgm::manifest::file stored = pgm::manifest::stat(path.string());
+	if (stored.modified == 0 || stored.modified < pgm::manifest::stat(object_path.string()).modified) {
+		return std::vector<diagnostic>();
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error.append(std::format("Error opening diagnostics file \"{}\".", path.string()));
+		return std::vector<diagnostic>();
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	return parse(text.str());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <filesystem>
+
+#include "error.hpp"
+
+namespace pgm {
+	// A warning, error or note from a compile, read from the compilers stderr.
+	// Diagnostics of each unit are stored next to its object so they can be printed again by builds that don't recompile the unit. Otherwise warnings disappear as soon as their object is up to date.
+	class diagnostic {
+		public:
+		// "warning", "error", "fatal error", "note" etc. as the compiler calls it.
+		std::string kind;
+		// Empty with line and column 0 for diagnostics without a location, e.g. about the command line.
+		std::string file;
+		unsigned line = 0;
+		unsigned column = 0;
+		std::string message;
+		// Option that enables the diagnostic, e.g. "-Wunused-variable". Empty for none.
+		std::string option;
+		// Notes that belong to this diagnostic, e.g. where a conflicting declaration is.
+		std::vector<diagnostic> children;
+
+		// The diagnostic and its children in the compilers one line format "file:line:column: kind: message [option]", each line ending in a newline.
+		std::string
+		render() const;
+
+		// Diagnostics in output, the stderr of a compile. Reads both GCC's "-fdiagnostics-format=json" lines and plain "file:line:column: kind: message" lines.
+		// Other lines (source excerpts, carets, "In function" and "compilation terminated.") are ignored. Notes in plain output belong to the diagnostic before them.
+		static std::vector<diagnostic>
+		parse(std::string_view output);
+
+		// output with each JSON line replaced by its diagnostics rendered as text, so it reads like a compile without "-fdiagnostics-format=json".
+		static std::string
+		render_output(std::string_view output);
+
+		// Path of the stored diagnostics of the unit compiled to object_path.
+		static std::filesystem::path
+		path(const std::filesystem::path &object_path);
+
+		// Stores diagnostics of the unit compiled to object_path. Removes stored diagnostics instead if there are none so clean units cost one failed stat to check.
+		static void
+		save(const std::filesystem::path &object_path, const std::vector<diagnostic> &diagnostics, error &error);
+
+		// Stored diagnostics of the unit compiled to object_path. Empty if there are none or they are older than the object, i.e. the object was compiled by something else since.
+		static std::vector<diagnostic>
+		load(const std::filesystem::path &object_path, error &error);
+	};
+}
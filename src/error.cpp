@@ -6,7 +6,7 @@
 
 pgm::error::error() : reason{reason_none} {}
 
-pgm::error::error(const std::string &message, int reason) {
+pgm::error::error(std::string_view message, int reason) {
 	append(message, reason);
 }
 
@@ -15,7 +15,7 @@ pgm::error::operator bool() const {
 }
 
 pgm::error &
-pgm::error::append(const std::string &message, int reason) {
+pgm::error::append(std::string_view message, int reason) {
 	this->reason = reason;
 	if (message.size() == 0) {
 		return *this;
@@ -39,10 +39,12 @@ pgm::error::print() const {
 	return reason;
 }
 
-pgm::error
+pgm::error &
 pgm::error::strerror() {
 	// This looks weird because the GNU version of strerror_r is weird and this is compatible.
-	char *message = static_cast<char *>(alloca(100));
-	message = strerror_r(errno, message, sizeof(message));
-	return append(std::string(message) + ".");
+	// GNU strerror_r may return a static string instead of writing to buffer so use the returned pointer. The XSI version returns an int which doesn't compile here, which is better than silently ignoring the message.
+	char buffer[256];
+	const char *message = strerror_r(errno, buffer, sizeof(buffer));
+	append(std::string(message) + ".");
+	return *this;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace pgm {
 	// Error handling strategy.
@@ -44,7 +45,8 @@ namespace pgm {
 		error();
 
 		// Constructs an error with message and reason. Indicates that an error has occurred.
-		error(const std::string &message, int reason = reason_other);
+		// Takes a string_view so literals and formatted strings are copied once, straight into message_stack.
+		error(std::string_view message, int reason = reason_other);
 
 		// Returns true if an error has occurred.
 		operator bool() const;
@@ -52,15 +54,16 @@ namespace pgm {
 		// Appends the highest level error message to the message stack and overrides the reason.
 		// Returns reference to *this for chaining.
 		error &
-		append(const std::string &message, int reason = reason_other);
+		append(std::string_view message, int reason = reason_other);
 
 		// Prints the message_stack and returns reason int (handy for exiting program e.g. "int main() {...; return something.error().append("OOPSIE WOOPSIE!! Uwu We made a fucky wucky!!").print();}").
 		// message_stack is only accessible through printing to prevent easy access to the user unit for the reasons stated above in the section about message_stack etc.
 		int
 		print() const;
 
-		// Constructs an error with message from errno in a thread safe way (using strerror_r instead of strerror).
-		error
+		// Appends the message of errno in a thread safe way (using strerror_r instead of strerror).
+		// Returns reference to *this for chaining like append, so "error.strerror().append(...)" adds both messages to this error.
+		error &
 		strerror();
 	};
 }
@@ -0,0 +1,291 @@
+#include "generators.hpp"
+
+#include <map>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <glob.h>
+
+#include "process.hpp"
+#include "compiler.hpp"
+#include "manifest.hpp"
+
+// First line of the state file. Changed when the format changes.
+static constexpr std::string_view state_magic = "cromple-generators 1";
+
+// Suffix of an output moved aside while its generator runs.
+static constexpr std::string_view previous_suffix = ".cromple-previous";
+
+// Files matching pattern, sorted. None if nothing matches.
+static std::vector<std::string>
+expand(const std::string &pattern) {
+	std::vector<std::string> paths;
+	glob_t matches;
+	if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+		paths.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+	}
+	globfree(&matches);
+	return paths;
+}
+
+static std::string
+read_file(const std::filesystem::path &path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::filesystem::path
+previous_path(const std::filesystem::path &output) {
+	std::filesystem::path path = output;
+	path += previous_suffix;
+	return path;
+}
+
+// Recorded states by generator name. Empty if there is no state file or it's from another version.
+static std::map<std::string, std::uint64_t>
+load_states(const std::filesystem::path &path) {
+	std::map<std::string, std::uint64_t> states;
+	std::ifstream file(path, std::ios::binary);
+	std::string line;
+	if (!std::getline(file, line) || line != state_magic) {
+		return states;
+	}
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::uint64_t state = 0;
+		std::string name;
+		if (stream >> std::hex >> state && std::getline(stream >> std::ws, name)) {
+			states[name] = state;
+		}
+	}
+	return states;
+}
+
+pgm::generators
+pgm::generators::load(const std::filesystem::path &path, error &error) {
+	pgm::generators generators;
+	do {
+		std::ifstream file(path);
+		if (!file) {
+			error.append(std::format("Can't open \"{}\".", path.string()));
+			break;
+		}
+
+		std::string line;
+		std::size_t line_number = 0;
+		while (std::getline(file, line)) {
+			line_number++;
+			std::istringstream stream(line);
+			std::string keyword;
+			if (!(stream >> keyword) || keyword.starts_with('#')) {
+				continue;
+			}
+			if (keyword == "generator") {
+				rule &rule = generators.rules.emplace_back();
+				if (!(stream >> rule.name)) {
+					error.append(std::format("Line {} \"{}\" has no generator name.", line_number, line));
+					break;
+				}
+				continue;
+			}
+			if (generators.rules.empty()) {
+				error.append(std::format("Line {} \"{}\" comes before the first \"generator NAME\" line.", line_number, line));
+				break;
+			}
+			rule &rule = generators.rules.back();
+			std::string value;
+			if (keyword == "inputs") {
+				while (stream >> value) {
+					rule.inputs.push_back(value);
+				}
+			} else if (keyword == "outputs") {
+				while (stream >> value) {
+					rule.outputs.push_back(value);
+				}
+			} else if (keyword == "command") {
+				std::getline(stream >> std::ws, rule.command);
+			} else {
+				error.append(std::format("Line {} \"{}\" starts with \"{}\" but only \"generator\", \"inputs\", \"outputs\" and \"command\" are understood.", line_number, line, keyword));
+				break;
+			}
+		}
+		if (error) {
+			break;
+		}
+
+		for (const rule &rule : generators.rules) {
+			if (rule.outputs.empty() || rule.command.empty()) {
+				error.append(std::format("Generator \"{}\" needs \"outputs\" and a \"command\".", rule.name));
+			}
+			for (const pgm::generators::rule &other : generators.rules) {
+				if (&other != &rule && other.name == rule.name) {
+					error.append(std::format("Generator \"{}\" is given more than once.", rule.name));
+					break;
+				}
+			}
+		}
+		if (error) {
+			break;
+		}
+		return generators;
+	} while (false);
+
+	error.append(std::format("Error loading generators from \"{}\".", path.string()));
+	return pgm::generators();
+}
+
+std::filesystem::path
+pgm::generators::state_path(const std::filesystem::path &object_directory) {
+	return object_directory / "cromple.generators";
+}
+
+std::uint64_t
+pgm::generators::state(const rule &rule) {
+	std::vector<std::string> parts = {rule.command};
+	auto add_file = [&parts](const std::string &path) {
+		pgm::manifest::file file = pgm::manifest::stat(path);
+		parts.insert(parts.end(), {path, std::to_string(file.modified), std::to_string(file.inode)});
+		return file.modified != 0;
+	};
+
+	for (const std::string &input : rule.inputs) {
+		parts.push_back(input);
+		for (const std::string &path : expand(input)) {
+			add_file(path);
+		}
+	}
+	for (const std::filesystem::path &output : rule.outputs) {
+		if (!add_file(output.string())) {
+			return 0;
+		}
+	}
+	return pgm::compiler::hash(parts);
+}
+
+bool
+pgm::generators::up_to_date(const std::filesystem::path &object_directory) const {
+	if (rules.empty()) {
+		return true;
+	}
+	std::map<std::string, std::uint64_t> states = load_states(state_path(object_directory));
+	for (const rule &rule : rules) {
+		std::map<std::string, std::uint64_t>::const_iterator recorded = states.find(rule.name);
+		if (recorded == states.end() || recorded->second != state(rule)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+pgm::generators::run(const std::filesystem::path &object_directory, const pgm::job_pool &job_pool, const std::atomic<bool> *cancelled, error &error) const {
+	if (rules.empty()) {
+		return;
+	}
+	do {
+		std::map<std::string, std::uint64_t> states = load_states(state_path(object_directory));
+
+		std::vector<pgm::job_pool::job> jobs;
+		std::vector<const rule *> job_rules;
+		for (const rule &rule : rules) {
+			std::map<std::string, std::uint64_t>::const_iterator recorded = states.find(rule.name);
+			if (recorded != states.end() && recorded->second == state(rule)) {
+				continue;
+			}
+
+			pgm::job_pool::job &job = jobs.emplace_back();
+			std::vector<std::string> command = {"/bin/sh", "-c", rule.command};
+			job.description = std::format("Error running generator \"{}\" with command \"{}\".", rule.name, rule.command);
+			job.start = [command](pgm::error &error) {
+				return process::exec(command, error);
+			};
+			job_rules.push_back(&rule);
+
+			// Move the outputs aside so they can be compared with what the command writes. They are put back below if the job never runs.
+			for (const std::filesystem::path &output : rule.outputs) {
+				std::error_code error_code;
+				if (output.has_parent_path()) {
+					std::filesystem::create_directories(output.parent_path(), error_code);
+				}
+				if (std::filesystem::exists(output, error_code)) {
+					std::filesystem::rename(output, previous_path(output), error_code);
+					if (error_code) {
+						error.append(std::format("Error moving output \"{}\" of generator \"{}\" aside: {}.", output.string(), rule.name, error_code.message()));
+						break;
+					}
+				}
+			}
+			if (error) {
+				break;
+			}
+		}
+
+		if (!error) {
+			job_pool.run(jobs, error, cancelled);
+		}
+
+		// Keep each output that didn't change as it was, with its modification time and inode, and throw away the previous version of the ones that did.
+		// Generators that failed or never ran get their previous outputs back.
+		for (std::vector<const rule *>::size_type i = 0; i < job_rules.size(); i++) {
+			const rule &rule = *job_rules[i];
+			bool succeeded = jobs[i].duration != std::chrono::steady_clock::duration::zero() && jobs[i].exit_status == 0;
+			for (const std::filesystem::path &output : rule.outputs) {
+				std::filesystem::path previous = previous_path(output);
+				std::error_code error_code;
+				if (!std::filesystem::exists(previous, error_code)) {
+					continue;
+				}
+				if (!succeeded || !std::filesystem::exists(output, error_code) || read_file(output) == read_file(previous)) {
+					std::filesystem::rename(previous, output, error_code);
+				} else {
+					std::filesystem::remove(previous, error_code);
+				}
+				if (error_code) {
+					error.append(std::format("Error putting back output \"{}\" of generator \"{}\": {}.", output.string(), rule.name, error_code.message()));
+				}
+			}
+			if (!succeeded) {
+				states.erase(rule.name);
+				continue;
+			}
+			std::uint64_t rule_state = state(rule);
+			if (rule_state == 0) {
+				states.erase(rule.name);
+				error.append(std::format("Generator \"{}\" succeeded but didn't write all of its outputs.", rule.name));
+				continue;
+			}
+			states[rule.name] = rule_state;
+		}
+
+		// Record the state even when a generator failed so the ones that succeeded don't run again.
+		std::filesystem::path path = state_path(object_directory);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << state_magic << "\n";
+		for (const rule &rule : rules) {
+			std::map<std::string, std::uint64_t>::const_iterator recorded = states.find(rule.name);
+			if (recorded != states.end()) {
+				file << std::format("{:016x} {}\n", recorded->second, rule.name);
+			}
+		}
+		file.close();
+		if (!file) {
+			error.append(std::format("Error writing generator state \"{}\".", path.string()));
+		}
+		if (error) {
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append("Error running generators.");
+}
+
+std::vector<std::filesystem::path>
+pgm::generators::outputs() const {
+	std::vector<std::filesystem::path> outputs;
+	for (const rule &rule : rules) {
+		outputs.insert(outputs.end(), rule.outputs.begin(), rule.outputs.end());
+	}
+	return outputs;
+}
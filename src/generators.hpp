@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include "error.hpp"
+#include "job_pool.hpp"
+
+namespace pgm {
+	// Commands that generate sources and headers before compiling, e.g. protoc, flex, bison or a script embedding resources. Read from the file given with "--generators":
+	//
+	// # Regenerated when a .proto file changes.
+	// generator protos
+	// inputs proto/*.proto
+	// outputs gen/messages.pb.cc gen/messages.pb.h
+	// command protoc --cpp_out=gen --proto_path=proto proto/messages.proto
+	//
+	// "generator NAME" starts a rule. "inputs" (globs) and "outputs" (paths) are separated by whitespace and can be given more than once. "command" is the rest of its line and is run by /bin/sh.
+	// Paths are relative to where cromple runs. Lines starting with "#" and empty lines are skipped.
+	//
+	// A generator only runs when the files matching its inputs, its outputs or its rule changed since it last ran.
+	// Outputs it writes with the same contents as before are put back so they keep their modification time and nothing that includes them is recompiled.
+	// Generated sources are compiled like the ones in the source directory. Generated headers need no special handling: compiles record the headers they include like any other.
+	class generators {
+		public:
+		class rule {
+			public:
+			std::string name;
+			// glob(3) patterns.
+			std::vector<std::string> inputs;
+			std::vector<std::filesystem::path> outputs;
+			std::string command;
+		};
+
+		// In the order of the file.
+		std::vector<rule> rules;
+
+		// Reads the rules in the file at path.
+		static generators
+		load(const std::filesystem::path &path, error &error);
+
+		// Path of the file in object_directory that records the state of the inputs and outputs of every generator when it last ran.
+		static std::filesystem::path
+		state_path(const std::filesystem::path &object_directory);
+
+		// True if no generator has to run. Only glob and stat calls.
+		bool
+		up_to_date(const std::filesystem::path &object_directory) const;
+
+		// Runs the generators that have to, in parallel on job_pool, and records their state in object_directory.
+		// Generators must not read each others outputs because they may run at the same time.
+		// Outputs of a generator that fails are put back as they were so it runs again next time.
+		void
+		run(const std::filesystem::path &object_directory, const pgm::job_pool &job_pool, const std::atomic<bool> *cancelled, error &error) const;
+
+		// Outputs of all generators. find_all compiles the sources among them.
+		std::vector<std::filesystem::path>
+		outputs() const;
+
+		private:
+		// Hash of rule and the paths, modification times and inodes of its inputs and outputs. 0 if an output is missing, which never matches a recorded state.
+		static std::uint64_t
+		state(const rule &rule);
+	};
+}
@@ -0,0 +1,140 @@
+#include "graph.hpp"
+
+#include <span>
+#include <format>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "json.hpp"
+
+// Escapes string for use inside a quoted DOT identifier.
+static std::string
+dot_escape(std::string_view string) {
+	std::string escaped;
+	for (char c : string) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+static std::string
+dot_quote(std::string_view string) {
+	return "\"" + dot_escape(string) + "\"";
+}
+
+// Prerequisites of unit without the source itself, which compilers always list first.
+// Changing the source only ever recompiles its own unit so it's not part of anyone elses blast radius.
+static std::span<const std::uint32_t>
+headers_of(const pgm::manifest &manifest, std::uint32_t unit) {
+	std::span<const std::uint32_t> prerequisites = manifest.prerequisites(unit);
+	return prerequisites.empty() ? prerequisites : prerequisites.subspan(1);
+}
+
+static std::string
+seconds(std::uint64_t nanoseconds) {
+	return std::format("{:.3f}", static_cast<double>(nanoseconds) / 1e9);
+}
+
+pgm::graph::graph(const pgm::manifest &manifest) : manifest{manifest} {}
+
+std::vector<pgm::graph::header>
+pgm::graph::rank() const {
+	// Indexed by path id. Paths are interned in the manifest so a header shared by many units is counted under one id.
+	std::unordered_map<std::uint32_t, header> headers;
+	for (std::uint32_t unit = 0; unit < manifest.unit_count(); unit++) {
+		for (std::uint32_t prerequisite : headers_of(manifest, unit)) {
+			header &header = headers[prerequisite];
+			header.fan_in++;
+			header.weighted_compile_time += manifest.unit_compile_time(unit);
+		}
+	}
+
+	std::vector<header> ranked;
+	ranked.reserve(headers.size());
+	for (std::pair<const std::uint32_t, header> &header : headers) {
+		header.second.path = manifest.path_of(header.first);
+		ranked.push_back(std::move(header.second));
+	}
+	std::sort(ranked.begin(), ranked.end(), [](const header &a, const header &b) {
+		if (a.weighted_compile_time != b.weighted_compile_time) {
+			return a.weighted_compile_time > b.weighted_compile_time;
+		}
+		if (a.fan_in != b.fan_in) {
+			return a.fan_in > b.fan_in;
+		}
+		return a.path < b.path;
+	});
+	return ranked;
+}
+
+void
+pgm::graph::write_json(std::ostream &stream) const {
+	stream << "{\n\t\"units\": [";
+	for (std::uint32_t unit = 0; unit < manifest.unit_count(); unit++) {
+		stream << (unit == 0 ? "\n" : ",\n");
+		stream << "\t\t{\"source\": " << pgm::json::quote(manifest.path_of(manifest.unit_source(unit)));
+		stream << ", \"object\": " << pgm::json::quote(manifest.path_of(manifest.unit_object(unit)));
+		stream << ", \"compile_seconds\": " << seconds(manifest.unit_compile_time(unit));
+		stream << ", \"prerequisites\": [";
+		bool first = true;
+		for (std::uint32_t prerequisite : manifest.prerequisites(unit)) {
+			stream << (first ? "" : ", ") << pgm::json::quote(manifest.path_of(prerequisite));
+			first = false;
+		}
+		stream << "]}";
+	}
+	stream << "\n\t],\n\t\"headers\": [";
+	std::vector<header> ranked = rank();
+	for (std::vector<header>::size_type i = 0; i < ranked.size(); i++) {
+		stream << (i == 0 ? "\n" : ",\n");
+		stream << "\t\t{\"path\": " << pgm::json::quote(ranked[i].path) << ", \"fan_in\": " << ranked[i].fan_in << ", \"weighted_compile_seconds\": " << seconds(ranked[i].weighted_compile_time) << "}";
+	}
+	stream << "\n\t]\n}\n";
+}
+
+void
+pgm::graph::write_dot(std::ostream &stream) const {
+	stream << "digraph prerequisites {\n";
+	stream << "\trankdir=LR;\n";
+	for (const header &header : rank()) {
+		// "\n" in a DOT label is a line break so it must not be escaped like the path.
+		stream << "\t" << dot_quote(header.path) << " [shape=box, label=\"" << dot_escape(header.path) << std::format("\\nfan-in {}, {}s\"];\n", header.fan_in, seconds(header.weighted_compile_time));
+	}
+	for (std::uint32_t unit = 0; unit < manifest.unit_count(); unit++) {
+		for (std::uint32_t prerequisite : headers_of(manifest, unit)) {
+			stream << "\t" << dot_quote(manifest.path_of(manifest.unit_source(unit))) << " -> " << dot_quote(manifest.path_of(prerequisite)) << ";\n";
+		}
+	}
+	stream << "}\n";
+}
+
+void
+pgm::graph::save(const std::filesystem::path &path, error &error) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		error.strerror().append(std::format("Error opening graph file \"{}\".", path.string()));
+		return;
+	}
+	if (path.extension() == ".dot") {
+		write_dot(file);
+	} else {
+		write_json(file);
+	}
+	file.close();
+	if (!file) {
+		error.append(std::format("Error writing graph file \"{}\".", path.string()));
+	}
+}
+
+void
+pgm::graph::print_ranking(std::ostream &stream, std::size_t count) const {
+	std::vector<header> ranked = rank();
+	stream << std::format("{:>8} {:>12}  {}", "fan-in", "cost", "header (cost is the compile time of the units that depend on it)") << std::endl;
+	for (std::vector<header>::size_type i = 0; i < ranked.size() && i < count; i++) {
+		stream << std::format("{:>8} {:>12}  {}", ranked[i].fan_in, seconds(ranked[i].weighted_compile_time) + "s", ranked[i].path) << std::endl;
+	}
+}
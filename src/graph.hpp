@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <filesystem>
+
+#include "error.hpp"
+#include "manifest.hpp"
+
+namespace pgm {
+	// Dependency graph of a configuration, read from its manifest, with the cost of changing each header.
+	// The graph has an edge from every unit to every file it depends on. Compilers only report the flattened set of headers a unit reads, not which header included which, so headers have no edges of their own.
+	// That is exactly what is needed to rank headers: the fan-in of a header is the number of units that recompile when it changes.
+	class graph {
+		public:
+		// Rebuild cost of one header.
+		class header {
+			public:
+			std::string path;
+			// Units that depend on the header, directly or through other headers.
+			std::size_t fan_in = 0;
+			// Sum of the last compile time of those units in nanoseconds. What changing the header costs.
+			std::uint64_t weighted_compile_time = 0;
+		};
+
+		graph(const pgm::manifest &manifest);
+
+		// Headers ranked by weighted_compile_time, then fan_in, most expensive first.
+		std::vector<header>
+		rank() const;
+
+		// Writes the graph and ranking as JSON.
+		void
+		write_json(std::ostream &stream) const;
+
+		// Writes the graph as a Graphviz DOT digraph. Header labels show their fan-in and cost.
+		void
+		write_dot(std::ostream &stream) const;
+
+		// Writes the graph to path as DOT if path ends in ".dot" and as JSON otherwise.
+		void
+		save(const std::filesystem::path &path, error &error) const;
+
+		// Prints the count most expensive headers as a table.
+		void
+		print_ranking(std::ostream &stream, std::size_t count) const;
+
+		private:
+		const pgm::manifest &manifest;
+	};
+}
@@ -0,0 +1,609 @@
+#include "include_scanner.hpp"
+
+#include <format>
+#include <cstring>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Characters the lexer has to stop at in normal code. Everything else can be skipped in bulk.
+static bool
+is_special(char c) {
+	return c == '\n' || c == '/' || c == '"' || c == '\'' || c == '#' || c == '\\';
+}
+
+static bool
+is_horizontal_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool
+is_identifier(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Returns the first special character in [p, end) or end.
+// This is where the lexer spends most of its time so it compares 16 bytes at a time.
+static const char *
+find_special(const char *p, const char *end) {
+#if defined(__SSE2__)
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i apostrophe = _mm_set1_epi8('\'');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	while (end - p >= 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i match = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, slash)),
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, apostrophe)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, hash), _mm_cmpeq_epi8(block, backslash))
+			)
+		);
+		int mask = _mm_movemask_epi8(match);
+		if (mask != 0) {
+			return p + __builtin_ctz(static_cast<unsigned>(mask));
+		}
+		p += 16;
+	}
+#endif
+	for (; p < end; p++) {
+		if (is_special(*p)) {
+			return p;
+		}
+	}
+	return end;
+}
+
+// Returns true if [p, end) contains anything other than horizontal whitespace.
+static bool
+has_code(const char *p, const char *end) {
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i carriage_return = _mm_set1_epi8('\r');
+	const __m128i form_feed = _mm_set1_epi8('\f');
+	const __m128i vertical_tab = _mm_set1_epi8('\v');
+	while (end - p >= 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i whitespace = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)),
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, carriage_return), _mm_cmpeq_epi8(block, form_feed)),
+				_mm_cmpeq_epi8(block, vertical_tab)
+			)
+		);
+		if (_mm_movemask_epi8(whitespace) != 0xffff) {
+			return true;
+		}
+		p += 16;
+	}
+#endif
+	for (; p < end; p++) {
+		if (!is_horizontal_space(*p)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Skips a block comment starting at p ("/*"). Returns the position after "*/" or end.
+static const char *
+skip_block_comment(const char *p, const char *end) {
+	p += 2;
+	while (p < end) {
+		const char *star = static_cast<const char *>(std::memchr(p, '*', static_cast<std::size_t>(end - p)));
+		if (star == nullptr || star + 1 >= end) {
+			return end;
+		}
+		if (star[1] == '/') {
+			return star + 2;
+		}
+		p = star + 1;
+	}
+	return end;
+}
+
+// Skips a line comment starting at p ("//"). Returns the position of the newline that ends it or end.
+static const char *
+skip_line_comment(const char *p, const char *end) {
+	while (p < end) {
+		const char *newline = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+		if (newline == nullptr) {
+			return end;
+		}
+		// A backslash before the newline continues the comment on the next line.
+		const char *before = newline - 1;
+		if (before >= p && *before == '\r') {
+			before--;
+		}
+		if (before < p || *before != '\\') {
+			return newline;
+		}
+		p = newline + 1;
+	}
+	return end;
+}
+
+// Skips a string or character literal starting at p (the opening quote). Returns the position after the closing quote, or the newline for unterminated literals.
+static const char *
+skip_literal(const char *p, const char *end) {
+	char quote = *p;
+	for (p++; p < end; p++) {
+		if (*p == '\\' && p + 1 < end) {
+			p++;
+			continue;
+		}
+		if (*p == quote) {
+			return p + 1;
+		}
+		if (*p == '\n') {
+			return p;
+		}
+	}
+	return end;
+}
+
+// Skips a raw string literal whose opening quote is at p, e.g. R"delimiter( ... )delimiter". Returns the position after it.
+static const char *
+skip_raw_literal(const char *p, const char *end) {
+	const char *open = static_cast<const char *>(std::memchr(p, '(', static_cast<std::size_t>(end - p)));
+	if (open == nullptr) {
+		return end;
+	}
+	std::string terminator = ")" + std::string(p + 1, open) + "\"";
+	std::string_view rest(open, static_cast<std::size_t>(end - open));
+	std::string_view::size_type found = rest.find(terminator);
+	if (found == std::string_view::npos) {
+		return end;
+	}
+	return open + found + terminator.size();
+}
+
+// Skips spaces, tabs, block comments and line continuations within a directive.
+static const char *
+skip_directive_space(const char *p, const char *end) {
+	while (p < end) {
+		if (is_horizontal_space(*p)) {
+			p++;
+		} else if (*p == '\\' && p + 1 < end && p[1] == '\n') {
+			p += 2;
+		} else if (*p == '\\' && p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+			p += 3;
+		} else if (*p == '/' && p + 1 < end && p[1] == '*') {
+			p = skip_block_comment(p, end);
+		} else {
+			break;
+		}
+	}
+	return p;
+}
+
+// Returns the position of the newline ending the directive that contains p, or end.
+// Comments and literals are skipped so a "//" or "/*" inside a string doesn't hide the end.
+static const char *
+skip_directive(const char *p, const char *end) {
+	while (p < end) {
+		char c = *p;
+		if (c == '\n') {
+			return p;
+		}
+		if (c == '\\' && p + 1 < end && p[1] == '\n') {
+			p += 2;
+		} else if (c == '\\' && p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+			p += 3;
+		} else if (c == '/' && p + 1 < end && p[1] == '*') {
+			p = skip_block_comment(p, end);
+		} else if (c == '/' && p + 1 < end && p[1] == '/') {
+			return skip_line_comment(p, end);
+		} else if (c == '"' || c == '\'') {
+			p = skip_literal(p, end);
+		} else {
+			p++;
+		}
+	}
+	return end;
+}
+
+// Macro tested by "#ifndef MACRO", "#if !defined(MACRO)" or "#if !defined MACRO", the conditions of an include guard. name is "ifndef" or "if" and the condition is [p, end).
+// Empty for any other condition, e.g. "#if !defined(A) && B".
+static std::string_view
+guard_condition(std::string_view name, const char *p, const char *end) {
+	p = skip_directive_space(p, end);
+	bool parenthesised = false;
+	if (name == "if") {
+		if (p == end || *p != '!') {
+			return {};
+		}
+		p = skip_directive_space(p + 1, end);
+		static constexpr std::string_view defined = "defined";
+		if (static_cast<std::size_t>(end - p) < defined.size() || std::string_view(p, defined.size()) != defined || (p + defined.size() < end && is_identifier(p[defined.size()]))) {
+			return {};
+		}
+		p = skip_directive_space(p + defined.size(), end);
+		if (p < end && *p == '(') {
+			parenthesised = true;
+			p = skip_directive_space(p + 1, end);
+		}
+	} else if (name != "ifndef") {
+		return {};
+	}
+	const char *macro_begin = p;
+	while (p < end && is_identifier(*p)) {
+		p++;
+	}
+	std::string_view macro(macro_begin, static_cast<std::size_t>(p - macro_begin));
+	p = skip_directive_space(p, end);
+	if (parenthesised) {
+		if (p == end || *p != ')') {
+			return {};
+		}
+		p = skip_directive_space(p + 1, end);
+	}
+	// Only a line comment may follow.
+	if (p != end && !(*p == '/' && p + 1 < end && p[1] == '/')) {
+		return {};
+	}
+	return macro;
+}
+
+pgm::include_scanner::include_scanner(const std::vector<std::string> &compiler_arguments) {
+	// Options that take a directory either attached ("-Idir") or as the next argument ("-I dir").
+	auto directory_option = [&compiler_arguments](std::vector<std::string>::size_type &i, const std::string &option, std::string &directory) {
+		const std::string &argument = compiler_arguments[i];
+		if (argument.compare(0, option.size(), option) != 0) {
+			return false;
+		}
+		if (argument.size() > option.size()) {
+			directory = argument.substr(option.size());
+			return true;
+		}
+		if (i + 1 < compiler_arguments.size()) {
+			directory = compiler_arguments[++i];
+			return true;
+		}
+		return false;
+	};
+
+	for (std::vector<std::string>::size_type i = 0; i < compiler_arguments.size(); i++) {
+		const std::string &argument = compiler_arguments[i];
+		std::string directory;
+		if (argument == "-include" || argument == "-imacros" || argument.starts_with("-include=") || argument == "-I-" || argument == "-nostdinc") {
+			disabled_reason = std::format("compiler argument \"{}\" is not supported by the native scanner", argument);
+		} else if (directory_option(i, "-iquote", directory)) {
+			quote_directories.push_back(directory);
+		} else if (directory_option(i, "-isystem", directory) || directory_option(i, "-idirafter", directory)) {
+			system_directories.push_back(directory);
+		} else if (argument.starts_with("-iprefix") || argument.starts_with("-iwithprefix") || argument.starts_with("-isysroot") || argument.starts_with("--sysroot")) {
+			disabled_reason = std::format("compiler argument \"{}\" is not supported by the native scanner", argument);
+		} else if (directory_option(i, "-I", directory)) {
+			bracket_directories.push_back(directory);
+		}
+	}
+}
+
+void
+pgm::include_scanner::add_system_directories(const std::vector<std::string> &directories) {
+	system_directories.insert(system_directories.end(), directories.begin(), directories.end());
+}
+
+bool
+pgm::include_scanner::prerequisites(const std::filesystem::path &source, std::vector<std::string> &prerequisites, std::string &reason) {
+	if (!disabled_reason.empty()) {
+		reason = disabled_reason;
+		return false;
+	}
+
+	prerequisites.clear();
+	prerequisites.push_back(source.string());
+	// Each header is listed once even if it's included many times, like -MM does with include guards and #pragma once.
+	std::unordered_set<std::string> visited {source.lexically_normal().string()};
+
+	// Depth first in order of first inclusion, which is the order -MM lists them in.
+	class frame {
+		public:
+		std::string path;
+		std::vector<include>::size_type next = 0;
+	};
+	std::vector<frame> stack {{source.string()}};
+	while (!stack.empty()) {
+		const file_includes &includes = lex_file(stack.back().path);
+		if (!includes.certain) {
+			reason = std::format("\"{}\": {}", stack.back().path, includes.reason);
+			return false;
+		}
+		if (stack.back().next == includes.includes.size()) {
+			stack.pop_back();
+			continue;
+		}
+		const include &include = includes.includes[stack.back().next++];
+
+		bool found;
+		bool system;
+		std::string resolved = resolve(stack.back().path, include, found, system);
+		// An angled include outside the system directories may still be found through an option the scanner doesn't understand, so it can't be skipped like a system header.
+		if (!found) {
+			reason = include.angled ? std::format("\"{}\": can't find <{}>", stack.back().path, include.name) : std::format("\"{}\": can't find \"{}\"", stack.back().path, include.name);
+			return false;
+		}
+		if (system) {
+			continue;
+		}
+		if (visited.insert(std::filesystem::path(resolved).lexically_normal().string()).second) {
+			prerequisites.push_back(resolved);
+			stack.push_back({resolved});
+		}
+	}
+	return true;
+}
+
+pgm::include_scanner::file_includes
+pgm::include_scanner::lex(const char *begin, const char *end) {
+	file_includes result;
+	auto uncertain = [&result](const std::string &reason) {
+		if (result.certain) {
+			result.certain = false;
+			result.reason = reason;
+		}
+	};
+
+	// Conditional nesting. Includes are only certain outside conditionals or directly inside an include guard.
+	int depth = 0;
+	bool first_directive = true;
+	// The first directive was #ifndef (or #if !defined) so depth 1 is assumed to be an include guard.
+	bool guarded = false;
+	// Macro tested by the guard. The next directive must #define it or the block is just a conditional, e.g. "#ifndef FEATURE" where something else defines FEATURE.
+	std::string_view guard_macro;
+	bool expect_guard_define = false;
+	// The guard was closed. Anything significant after it means it wasn't a guard after all.
+	bool after_guard = false;
+	bool guard_broken = false;
+	bool included_in_guard = false;
+
+	// True when something other than whitespace or comments came before p on the current line.
+	bool line_has_code = false;
+	const char *p = begin;
+	// Start of the text since the last token handled. Only checked for code when it matters.
+	const char *checked = begin;
+
+	while (p < end) {
+		p = find_special(p, end);
+		if (!line_has_code && has_code(checked, p)) {
+			line_has_code = true;
+		}
+		if (p == end) {
+			break;
+		}
+
+		char c = *p;
+		if (c == '\n') {
+			if (after_guard && line_has_code) {
+				guard_broken = true;
+			}
+			line_has_code = false;
+			p++;
+		} else if (c == '\\') {
+			// Line continuation joins lines so it doesn't start a new line.
+			if (p + 1 < end && p[1] == '\n') {
+				p += 2;
+			} else if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+				p += 3;
+			} else {
+				line_has_code = true;
+				p++;
+			}
+		} else if (c == '/' && p + 1 < end && p[1] == '/') {
+			p = skip_line_comment(p, end);
+		} else if (c == '/' && p + 1 < end && p[1] == '*') {
+			p = skip_block_comment(p, end);
+		} else if (c == '"') {
+			line_has_code = true;
+			// Raw string literal, e.g. R"(...)" or u8R"x(...)x".
+			if (p > begin && p[-1] == 'R' && (p - 1 == begin || !is_identifier(p[-2]) || p[-2] == '8' || p[-2] == 'u' || p[-2] == 'U' || p[-2] == 'L')) {
+				p = skip_raw_literal(p, end);
+			} else {
+				p = skip_literal(p, end);
+			}
+		} else if (c == '\'') {
+			line_has_code = true;
+			// Digit separators like 1'000'000 are not character literals.
+			const char *token = p;
+			while (token > begin && (is_identifier(token[-1]) || token[-1] == '.' || token[-1] == '\'')) {
+				token--;
+			}
+			if (token < p && *token >= '0' && *token <= '9') {
+				p++;
+			} else {
+				p = skip_literal(p, end);
+			}
+		} else if (c == '#' && !line_has_code) {
+			const char *directive_end = skip_directive(p, end);
+			std::string_view line(p, static_cast<std::size_t>(directive_end - p));
+
+			const char *name_begin = skip_directive_space(p + 1, directive_end);
+			const char *name_end = name_begin;
+			while (name_end < directive_end && is_identifier(*name_end)) {
+				name_end++;
+			}
+			std::string_view name(name_begin, static_cast<std::size_t>(name_end - name_begin));
+
+			if (after_guard && !name.empty()) {
+				guard_broken = true;
+			}
+			if (expect_guard_define && !name.empty()) {
+				const char *macro_begin = skip_directive_space(name_end, directive_end);
+				const char *macro_end = macro_begin;
+				while (macro_end < directive_end && is_identifier(*macro_end)) {
+					macro_end++;
+				}
+				if (name != "define" || std::string_view(macro_begin, static_cast<std::size_t>(macro_end - macro_begin)) != guard_macro) {
+					guard_broken = true;
+				}
+				expect_guard_define = false;
+			}
+			if (line.find("__has_include") != std::string_view::npos) {
+				uncertain("uses __has_include");
+			}
+
+			if (name == "include") {
+				const char *q = skip_directive_space(name_end, directive_end);
+				char close = q < directive_end && *q == '"' ? '"' : q < directive_end && *q == '<' ? '>' : '\0';
+				const char *name_close = close == '\0' ? nullptr : static_cast<const char *>(std::memchr(q + 1, close, static_cast<std::size_t>(directive_end - q - 1)));
+				if (name_close == nullptr) {
+					uncertain("computed or malformed #include");
+				} else if (depth > 1 || (depth == 1 && !guarded)) {
+					uncertain("#include inside a conditional block");
+				} else {
+					result.includes.push_back({std::string(q + 1, name_close), close == '>'});
+					included_in_guard = included_in_guard || depth == 1;
+				}
+			} else if (name == "include_next" || name == "import") {
+				uncertain(std::format("uses #{}", name));
+			} else if (name == "if" || name == "ifdef" || name == "ifndef") {
+				if (first_directive && depth == 0) {
+					guard_macro = guard_condition(name, name_end, directive_end);
+					guarded = !guard_macro.empty();
+					expect_guard_define = guarded;
+				}
+				depth++;
+			} else if (name == "elif" || name == "else" || name == "elifdef" || name == "elifndef") {
+				if (depth == 1 && guarded) {
+					guard_broken = true;
+				}
+			} else if (name == "endif") {
+				depth--;
+				if (depth == 0 && guarded) {
+					after_guard = true;
+				}
+			}
+			if (!name.empty()) {
+				first_directive = false;
+			}
+
+			p = directive_end;
+		} else {
+			line_has_code = true;
+			p++;
+		}
+		checked = p;
+	}
+
+	if (after_guard && line_has_code) {
+		guard_broken = true;
+	}
+	if (guard_broken && included_in_guard) {
+		uncertain("#include inside a conditional block that is not an include guard");
+	}
+	return result;
+}
+
+const pgm::include_scanner::file_includes &
+pgm::include_scanner::lex_file(const std::string &path) {
+	std::unordered_map<std::string, file_includes>::iterator iterator = lexed.find(path);
+	if (iterator != lexed.end()) {
+		return iterator->second;
+	}
+
+	file_includes includes;
+	do {
+		int file_descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file_descriptor == -1) {
+			includes.certain = false;
+			includes.reason = std::format("can't open: {}", std::strerror(errno));
+			break;
+		}
+		struct stat status;
+		if (::fstat(file_descriptor, &status) == -1) {
+			includes.certain = false;
+			includes.reason = std::format("can't stat: {}", std::strerror(errno));
+			::close(file_descriptor);
+			break;
+		}
+		// Empty files can't be mapped and have nothing to include anyway.
+		if (status.st_size == 0) {
+			::close(file_descriptor);
+			break;
+		}
+		std::size_t size = static_cast<std::size_t>(status.st_size);
+		void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		::close(file_descriptor);
+		if (mapping == MAP_FAILED) {
+			includes.certain = false;
+			includes.reason = std::format("can't map: {}", std::strerror(errno));
+			break;
+		}
+		const char *begin = static_cast<const char *>(mapping);
+		includes = lex(begin, begin + size);
+		::munmap(mapping, size);
+	} while (false);
+
+	return lexed.emplace(path, std::move(includes)).first->second;
+}
+
+std::string
+pgm::include_scanner::resolve(const std::string &includer, const include &include, bool &found, bool &system) {
+	found = true;
+	system = false;
+
+	// Paths are built like the compiler builds them so they match -MM output.
+	auto join = [](const std::string &directory, const std::string &name) {
+		if (directory.empty()) {
+			return name;
+		}
+		return directory.back() == '/' ? directory + name : directory + "/" + name;
+	};
+
+	if (!include.name.empty() && include.name[0] == '/') {
+		return exists(include.name) ? include.name : (found = false, std::string());
+	}
+
+	if (!include.angled) {
+		std::string directory = std::filesystem::path(includer).parent_path().string();
+		std::string candidate = join(directory, include.name);
+		if (exists(candidate)) {
+			return candidate;
+		}
+		for (const std::string &directory : quote_directories) {
+			candidate = join(directory, include.name);
+			if (exists(candidate)) {
+				return candidate;
+			}
+		}
+	}
+	for (const std::string &directory : bracket_directories) {
+		std::string candidate = join(directory, include.name);
+		if (exists(candidate)) {
+			return candidate;
+		}
+	}
+	for (const std::string &directory : system_directories) {
+		std::string candidate = join(directory, include.name);
+		if (exists(candidate)) {
+			system = true;
+			return candidate;
+		}
+	}
+	found = false;
+	return std::string();
+}
+
+bool
+pgm::include_scanner::exists(const std::string &path) {
+	std::unordered_map<std::string, bool>::iterator iterator = existing.find(path);
+	if (iterator != existing.end()) {
+		return iterator->second;
+	}
+	struct stat status;
+	bool exists = ::stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+	existing.emplace(path, exists);
+	return exists;
+}
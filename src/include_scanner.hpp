@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace pgm {
+	// Finds the prerequisites of a source without running the compiler.
+	// Sources and headers are memory mapped and lexed with SSE2 where available to find #include directives, which are resolved against the include directories from the compiler arguments the same way the compiler would.
+	// Headers are lexed once per invocation and shared by all units that include them.
+	//
+	// This is not a preprocessor. Whenever the result could differ from compiler -MM it says so and the caller should ask the compiler instead:
+	// includes inside conditional blocks (other than an include guard: #ifndef or #if !defined of a macro that the next directive #defines, closed by the last directive), computed includes (#include MACRO), #include_next, __has_include, forced includes (-include) and includes that can't be found.
+	// Headers found in -isystem directories or in the compilers own directories given to add_system_directories are treated as system headers and left out like -MM does.
+	class include_scanner {
+		public:
+		// Takes include directories from compiler_arguments.
+		include_scanner(const std::vector<std::string> &compiler_arguments);
+
+		// Adds the directories the compiler searches for <name> without being told, see compiler::system_include_directories.
+		// Without them every include of a standard header can't be found and makes the result uncertain.
+		void
+		add_system_directories(const std::vector<std::string> &directories);
+
+		// Finds the source and user headers that source includes, like compiler -MM.
+		// Returns false when the result can't be trusted. reason then says why.
+		bool
+		prerequisites(const std::filesystem::path &source, std::vector<std::string> &prerequisites, std::string &reason);
+
+		private:
+		class include {
+			public:
+			std::string name;
+			// <name> instead of "name".
+			bool angled;
+		};
+
+		// What lexing one file found.
+		class file_includes {
+			public:
+			bool certain = true;
+			std::string reason;
+			std::vector<include> includes;
+		};
+
+		// Lexes a buffer for #include directives.
+		static file_includes
+		lex(const char *begin, const char *end);
+
+		// Lexes the file at path, memory mapping it. Cached by path.
+		const file_includes &
+		lex_file(const std::string &path);
+
+		// Resolves an include in includer. Sets found to false when the include can't be found and system to true when it was found as a system header.
+		std::string
+		resolve(const std::string &includer, const include &include, bool &found, bool &system);
+
+		bool
+		exists(const std::string &path);
+
+		// Directories searched for "name" after the includers directory.
+		std::vector<std::string> quote_directories;
+		// Directories searched for both "name" and <name>.
+		std::vector<std::string> bracket_directories;
+		// Directories of system headers that -MM leaves out.
+		std::vector<std::string> system_directories;
+		// Set when the compiler arguments make scanning unreliable. Every call then returns false with this reason.
+		std::string disabled_reason;
+
+		std::unordered_map<std::string, file_includes> lexed;
+		std::unordered_map<std::string, bool> existing;
+	};
+}
@@ -0,0 +1,179 @@
+#include "job_pool.hpp"
+
+#include <list>
+#include <deque>
+#include <format>
+
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+pgm::job_pool::job_pool(unsigned jobs) : jobs{jobs} {}
+
+void
+pgm::job_pool::run(std::vector<job> &jobs, error &error, const std::atomic<bool> *cancelled) const {
+	// A job that has been started and not yet reaped.
+	// Use a list because process::child has const members so it can't be moved around inside a vector when erasing.
+	class running {
+		public:
+		pgm::job_pool::job &job;
+		std::vector<pgm::job_pool::job>::size_type index;
+		process::child child;
+		std::chrono::steady_clock::time_point started;
+		bool stdout_open = true;
+		bool stderr_open = true;
+	};
+	std::list<running> running_jobs;
+
+	// Number of unfinished dependencies of each job and the jobs waiting on each job.
+	std::vector<std::size_t> waiting_for(jobs.size());
+	std::vector<std::vector<std::vector<pgm::job_pool::job>::size_type>> dependents(jobs.size());
+	for (std::vector<pgm::job_pool::job>::size_type i = 0; i < jobs.size(); i++) {
+		waiting_for[i] = jobs[i].dependencies.size();
+		for (std::size_t dependency : jobs[i].dependencies) {
+			dependents[dependency].push_back(i);
+		}
+	}
+	// Jobs whose dependencies have all finished, in the order they were given.
+	std::deque<std::vector<pgm::job_pool::job>::size_type> ready;
+	for (std::vector<pgm::job_pool::job>::size_type i = 0; i < jobs.size(); i++) {
+		if (waiting_for[i] == 0) {
+			ready.push_back(i);
+		}
+	}
+	std::vector<pgm::job_pool::job>::size_type finished = 0;
+	// Set when a job fails so no new jobs are started. Running jobs are still drained and waited for so no zombies are left behind.
+	bool stopping = false;
+	// Poll wakes up this often to notice cancellation when nothing is written to the pipes.
+	constexpr int cancel_poll_milliseconds = 100;
+
+	while (true) {
+		if (cancelled != nullptr && *cancelled && !stopping) {
+			error.append("Cancelled.");
+			stopping = true;
+			// Compiler drivers don't pass the signal on to the compiler proper, which would keep the pipes open until it's done, so stop reading and only wait for the driver.
+			for (running &running : running_jobs) {
+				::kill(running.child.pid, SIGTERM);
+				running.stdout_open = false;
+				running.stderr_open = false;
+			}
+		}
+
+		// Start as many jobs as allowed.
+		while (!stopping && !ready.empty() && running_jobs.size() < this->jobs) {
+			std::vector<pgm::job_pool::job>::size_type index = ready.front();
+			ready.pop_front();
+			job &job = jobs[index];
+			std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+			process::child child = job.start(error);
+			if (error) {
+				error.append(job.description);
+				stopping = true;
+				break;
+			}
+			running_jobs.push_back({job, index, child, started});
+			if (job.started) {
+				job.started(job);
+			}
+		}
+
+		if (running_jobs.empty()) {
+			// Nothing running and nothing ready but not everything finished means the remaining jobs wait on each other.
+			if (!stopping && finished < jobs.size()) {
+				error.append(std::format("{} jobs can't start because their dependencies form a cycle.", jobs.size() - finished));
+				for (std::vector<pgm::job_pool::job>::size_type i = 0; i < jobs.size(); i++) {
+					if (waiting_for[i] != 0) {
+						error.append(jobs[i].description);
+					}
+				}
+			}
+			break;
+		}
+
+		// Wait for output from any running job.
+		std::vector<pollfd> poll_fds;
+		std::vector<std::pair<running *, bool /* is stdout */>> poll_owners;
+		for (running &running : running_jobs) {
+			if (running.stdout_open) {
+				poll_fds.push_back({running.child.stdout, POLLIN, 0});
+				poll_owners.push_back({&running, true});
+			}
+			if (running.stderr_open) {
+				poll_fds.push_back({running.child.stderr, POLLIN, 0});
+				poll_owners.push_back({&running, false});
+			}
+		}
+		if (!poll_fds.empty() && ::poll(poll_fds.data(), poll_fds.size(), cancelled != nullptr && !stopping ? cancel_poll_milliseconds : -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			error.strerror().append("Error polling child process pipes.");
+			stopping = true;
+			// Stop reading so the running jobs are reaped below instead of polling forever.
+			for (running &running : running_jobs) {
+				running.stdout_open = false;
+				running.stderr_open = false;
+			}
+		}
+
+		// Drain readable pipes. A read of 0 bytes means the child closed its end.
+		for (std::vector<pollfd>::size_type i = 0; i < poll_fds.size(); i++) {
+			if (poll_fds[i].revents == 0) {
+				continue;
+			}
+			auto [running, is_stdout] = poll_owners[i];
+			char buffer[4096];
+			ssize_t bytes_read = ::read(poll_fds[i].fd, buffer, sizeof(buffer));
+			if (bytes_read > 0) {
+				(is_stdout ? running->job.stdout_output : running->job.stderr_output).append(buffer, static_cast<size_t>(bytes_read));
+				continue;
+			}
+			if (bytes_read == -1 && errno == EINTR) {
+				continue;
+			}
+			(is_stdout ? running->stdout_open : running->stderr_open) = false;
+		}
+
+		// Reap jobs whose pipes have both been closed.
+		for (std::list<running>::iterator iterator = running_jobs.begin(); iterator != running_jobs.end();) {
+			if (iterator->stdout_open || iterator->stderr_open) {
+				++iterator;
+				continue;
+			}
+			job &job = iterator->job;
+			std::vector<pgm::job_pool::job>::size_type index = iterator->index;
+			pgm::error job_error;
+			job.exit_status = iterator->child.wait(job_error);
+			job.duration = std::chrono::steady_clock::now() - iterator->started;
+			iterator->child.close(job_error);
+			iterator = running_jobs.erase(iterator);
+			if (job.finished) {
+				job.finished(job);
+			}
+
+			if (!job_error && job.exit_status != 0) {
+				job_error
+					.append(job.format_stderr ? job.format_stderr(job.stderr_output) : job.stderr_output)
+					.append(std::format("Exit status {}.", job.exit_status))
+				;
+			}
+			// Only report the first failure. Later failures are usually caused by the same mistake.
+			if (job_error && !error) {
+				error = job_error;
+				error.append(job.description);
+			}
+			if (job_error) {
+				stopping = true;
+				continue;
+			}
+
+			// Dependents of a successful job may now be able to start.
+			finished++;
+			for (std::vector<pgm::job_pool::job>::size_type dependent : dependents[index]) {
+				if (--waiting_for[dependent] == 0) {
+					ready.push_back(dependent);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "error.hpp"
+#include "process.hpp"
+
+namespace pgm {
+	// Runs child processes in parallel with at most a fixed number running at the same time.
+	// All jobs of an invocation go through one pool so compiles from different configurations share the same parallelism.
+	class job_pool {
+		public:
+		class job {
+			public:
+			// Starts the child process for this job. Typically a wrapper around process::exec.
+			std::function<process::child (error &error)> start;
+			// Appended to the error when the job fails. Should describe what the job was doing and with which command.
+			std::string description;
+			// Indices into the jobs given to run of jobs that must finish successfully before this job starts, e.g. compiles of the module interfaces this unit imports.
+			std::vector<std::size_t> dependencies;
+			// Turns the stderr of the job into the text appended to the error when it fails, e.g. to render machine readable diagnostics. Empty appends stderr as it is.
+			std::function<std::string (const std::string &stderr_output)> format_stderr;
+			// Called right after the child was started and after it was reaped, successful or not. Either can be empty.
+			std::function<void (const job &job)> started;
+			std::function<void (const job &job)> finished;
+
+			// Set by run.
+			int exit_status = 0;
+			std::string stdout_output;
+			std::string stderr_output;
+			// Wall time from starting the child to reaping it.
+			std::chrono::steady_clock::duration duration{};
+		};
+
+		job_pool(unsigned jobs);
+
+		// Runs all jobs and waits for them to finish.
+		// Jobs start in order as soon as their dependencies have finished, so independent jobs keep every slot busy while a chain of dependent jobs runs.
+		// Stdout and stderr of every job are drained while it runs so a chatty child can never block on a full pipe.
+		// The first failing job stops new jobs from starting, running jobs are waited for and the failure is reported in error.
+		// Jobs that can never start because their dependencies form a cycle are reported in error too.
+		// Setting cancelled, e.g. from another thread, stops new jobs from starting and sends SIGTERM to the running ones. They are still waited for.
+		void
+		run(std::vector<job> &jobs, error &error, const std::atomic<bool> *cancelled = nullptr) const;
+
+		private:
+		unsigned jobs;
+	};
+}
@@ -0,0 +1,278 @@
+#include "json.hpp"
+
+#include <format>
+#include <cstdlib>
+
+// Deeply nested documents are rejected instead of overflowing the stack. Compiler output never comes close.
+static constexpr unsigned maximum_depth = 256;
+
+static void
+skip_whitespace(std::string_view text, std::string_view::size_type &position) {
+	while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+		position++;
+	}
+}
+
+// Appends code_point to string as UTF-8.
+static void
+append_utf8(std::string &string, unsigned long code_point) {
+	if (code_point < 0x80) {
+		string += static_cast<char>(code_point);
+	} else if (code_point < 0x800) {
+		string += static_cast<char>(0xc0 | (code_point >> 6));
+		string += static_cast<char>(0x80 | (code_point & 0x3f));
+	} else if (code_point < 0x10000) {
+		string += static_cast<char>(0xe0 | (code_point >> 12));
+		string += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+		string += static_cast<char>(0x80 | (code_point & 0x3f));
+	} else {
+		string += static_cast<char>(0xf0 | (code_point >> 18));
+		string += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+		string += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+		string += static_cast<char>(0x80 | (code_point & 0x3f));
+	}
+}
+
+const pgm::json *
+pgm::json::find(std::string_view key) const {
+	if (kind != pgm::json::kind::object) {
+		return nullptr;
+	}
+	for (std::vector<std::string>::size_type i = 0; i < keys.size(); i++) {
+		if (keys[i] == key) {
+			return &elements[i];
+		}
+	}
+	return nullptr;
+}
+
+std::string
+pgm::json::quote(std::string_view string) {
+	std::string quoted = "\"";
+	for (char c : string) {
+		switch (c) {
+			case '"': quoted += "\\\""; break;
+			case '\\': quoted += "\\\\"; break;
+			case '\n': quoted += "\\n"; break;
+			case '\r': quoted += "\\r"; break;
+			case '\t': quoted += "\\t"; break;
+			default:
+				// Other control characters have no short escape.
+				if (static_cast<unsigned char>(c) < 0x20) {
+					static constexpr char hex[] = "0123456789abcdef";
+					quoted += "\\u00";
+					quoted += hex[(c >> 4) & 0xf];
+					quoted += hex[c & 0xf];
+				} else {
+					quoted += c;
+				}
+		}
+	}
+	return quoted + "\"";
+}
+
+pgm::json
+pgm::json::parse(std::string_view text, error &error) {
+	std::string_view::size_type position = 0;
+	pgm::json value = parse_value(text, position, 0, error);
+	do {
+		if (error) {
+			break;
+		}
+		skip_whitespace(text, position);
+		if (position != text.size()) {
+			error.append(std::format("Unexpected \"{}\" after the end of the value at offset {}.", text[position], position));
+			break;
+		}
+		return value;
+	} while (false);
+
+	error.append("Error parsing JSON.");
+	return pgm::json();
+}
+
+pgm::json
+pgm::json::parse_value(std::string_view text, std::string_view::size_type &position, unsigned depth, error &error) {
+	pgm::json value;
+	do {
+		if (depth > maximum_depth) {
+			error.append(std::format("Values are nested deeper than {} levels at offset {}.", maximum_depth, position));
+			break;
+		}
+
+		skip_whitespace(text, position);
+		if (position == text.size()) {
+			error.append("Unexpected end of text where a value was expected.");
+			break;
+		}
+
+		char c = text[position];
+		if (c == '{' || c == '[') {
+			bool is_object = c == '{';
+			char close = is_object ? '}' : ']';
+			value.kind = is_object ? pgm::json::kind::object : pgm::json::kind::array;
+			position++;
+			skip_whitespace(text, position);
+			if (position < text.size() && text[position] == close) {
+				position++;
+				return value;
+			}
+			while (true) {
+				if (is_object) {
+					skip_whitespace(text, position);
+					std::string key = parse_string(text, position, error);
+					if (error) {
+						break;
+					}
+					skip_whitespace(text, position);
+					if (position == text.size() || text[position] != ':') {
+						error.append(std::format("Expected \":\" after object key \"{}\" at offset {}.", key, position));
+						break;
+					}
+					position++;
+					value.keys.push_back(std::move(key));
+				}
+				value.elements.push_back(parse_value(text, position, depth + 1, error));
+				if (error) {
+					break;
+				}
+				skip_whitespace(text, position);
+				if (position < text.size() && text[position] == ',') {
+					position++;
+					continue;
+				}
+				if (position < text.size() && text[position] == close) {
+					position++;
+					break;
+				}
+				error.append(std::format("Expected \",\" or \"{}\" at offset {}.", close, position));
+				break;
+			}
+			if (error) {
+				break;
+			}
+			return value;
+		}
+
+		if (c == '"') {
+			value.kind = pgm::json::kind::string;
+			value.string = parse_string(text, position, error);
+			if (error) {
+				break;
+			}
+			return value;
+		}
+
+		for (std::string_view literal : {"true", "false", "null"}) {
+			if (text.substr(position, literal.size()) == literal) {
+				position += literal.size();
+				value.kind = literal == "null" ? pgm::json::kind::null : pgm::json::kind::boolean;
+				value.boolean = literal == "true";
+				return value;
+			}
+		}
+
+		if (c == '-' || (c >= '0' && c <= '9')) {
+			// strtod needs a terminated string and accepts more than JSON does (hex, inf) so only hand it the characters a JSON number can have.
+			std::string_view::size_type end = position;
+			while (end < text.size() && std::string_view("+-0123456789.eE").find(text[end]) != std::string_view::npos) {
+				end++;
+			}
+			std::string number(text.substr(position, end - position));
+			char *number_end = nullptr;
+			value.kind = pgm::json::kind::number;
+			value.number = std::strtod(number.c_str(), &number_end);
+			if (number_end != number.c_str() + number.size()) {
+				error.append(std::format("Invalid number \"{}\" at offset {}.", number, position));
+				break;
+			}
+			position = end;
+			return value;
+		}
+
+		error.append(std::format("Unexpected \"{}\" at offset {}.", c, position));
+	} while (false);
+
+	return pgm::json();
+}
+
+std::string
+pgm::json::parse_string(std::string_view text, std::string_view::size_type &position, error &error) {
+	std::string string;
+	do {
+		if (position == text.size() || text[position] != '"') {
+			error.append(std::format("Expected a string at offset {}.", position));
+			break;
+		}
+		position++;
+
+		while (position < text.size() && text[position] != '"') {
+			char c = text[position++];
+			if (c != '\\') {
+				string += c;
+				continue;
+			}
+			if (position == text.size()) {
+				break;
+			}
+			char escaped = text[position++];
+			switch (escaped) {
+				case '"': string += '"'; break;
+				case '\\': string += '\\'; break;
+				case '/': string += '/'; break;
+				case 'b': string += '\b'; break;
+				case 'f': string += '\f'; break;
+				case 'n': string += '\n'; break;
+				case 'r': string += '\r'; break;
+				case 't': string += '\t'; break;
+				case 'u': {
+					// Reads the 4 hex digits after "\u".
+					auto read_code_unit = [&text, &position](unsigned long &code_unit) {
+						if (text.size() - position < 4) {
+							return false;
+						}
+						std::string digits(text.substr(position, 4));
+						char *end = nullptr;
+						code_unit = std::strtoul(digits.c_str(), &end, 16);
+						position += 4;
+						return end == digits.c_str() + 4;
+					};
+					unsigned long code_point;
+					if (!read_code_unit(code_point)) {
+						error.append(std::format("Invalid \\u escape at offset {}.", position));
+						break;
+					}
+					// Characters outside the basic multilingual plane are written as a surrogate pair.
+					if (code_point >= 0xd800 && code_point < 0xdc00 && text.substr(position, 2) == "\\u") {
+						position += 2;
+						unsigned long low;
+						if (!read_code_unit(low) || low < 0xdc00 || low >= 0xe000) {
+							error.append(std::format("Invalid surrogate pair at offset {}.", position));
+							break;
+						}
+						code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+					}
+					append_utf8(string, code_point);
+					break;
+				}
+				default:
+					error.append(std::format("Invalid escape \"\\{}\" at offset {}.", escaped, position - 1));
+			}
+			if (error) {
+				break;
+			}
+		}
+		if (error) {
+			break;
+		}
+
+		if (position == text.size()) {
+			error.append("Unterminated string.");
+			break;
+		}
+		position++;
+		return string;
+	} while (false);
+
+	return std::string();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string_view>
+
+#include "error.hpp"
+
+namespace pgm {
+	// Minimal JSON document. Just enough to read the dependency files compilers write (P1689) without pulling in a library.
+	// Numbers are kept as doubles and objects keep their members in file order with duplicate keys allowed.
+	class json {
+		public:
+		enum class kind {
+			null,
+			boolean,
+			number,
+			string,
+			array,
+			object,
+		};
+
+		pgm::json::kind kind = pgm::json::kind::null;
+		bool boolean = false;
+		double number = 0;
+		std::string string;
+		// Elements of an array or values of an object.
+		std::vector<json> elements;
+		// Keys of an object. keys[i] is the key of elements[i].
+		std::vector<std::string> keys;
+
+		// Returns the value of the first member called key, or nullptr if this is not an object or has no such member.
+		const json *
+		find(std::string_view key) const;
+
+		// Returns string as a quoted and escaped JSON string.
+		static std::string
+		quote(std::string_view string);
+
+		// Parses text, which must be exactly one JSON value surrounded by optional whitespace.
+		static json
+		parse(std::string_view text, error &error);
+
+		private:
+		static json
+		parse_value(std::string_view text, std::string_view::size_type &position, unsigned depth, error &error);
+
+		static std::string
+		parse_string(std::string_view text, std::string_view::size_type &position, error &error);
+	};
+}
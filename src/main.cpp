@@ -3,68 +3,223 @@
 #include <expected>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 #include <regex>
 #include <chrono>
+#include <algorithm>
 
 #include <cstring>
 
 #include "arguments.hpp"
 #include "error.hpp"
-#include "translation_unit.hpp"
+#include "project.hpp"
 #include "compiler.hpp"
+#include "manifest.hpp"
+#include "graph.hpp"
+#include "profile.hpp"
+#include "diagnostic.hpp"
 
 int main(int argc, char *argv[]) {
 	pgm::error error;
 
-	pgm::arguments arguments = pgm::arguments::parse(argc, argv);
+	pgm::arguments arguments = pgm::arguments::parse(argc, argv, error);
+	if (error) {
+		return error.print();
+	}
 
 	if (arguments.help) {
-		std::cout << "Usage: cromple [--compiler COMPILER (default: /usr/bin/g++)] [--source SOURCE_DIRECTORY (default: src)] [--objects OBJECT_DIRECTORY (default: obj)] [-o OUTPUT_FILE (default: a.out)] [COMPILER_OPTIONS]" << std::endl;
+		std::cout << "Usage: cromple [--compiler COMPILER (default: /usr/bin/g++)] [--source SOURCE_DIRECTORY (default: src)] [--objects OBJECT_DIRECTORY (default: obj)] [-o OUTPUT_FILE (default: a.out)] [--jobs JOBS (default: number of CPUs)] [--workers HOST:PORT[,HOST:PORT]...] [--worker-timeout SECONDS (default: 300)] [--scanner compiler|native|verify (default: compiler)] [--modules] [--explain] [--graph FILE.json|FILE.dot] [--profile FILE] [--overrides FILE] [--generators FILE] [--lto] [--shard K/N [--shard-costs MANIFEST]] [--merge OBJECT_DIRECTORY[,OBJECT_DIRECTORY]...] [COMPILER_OPTIONS] [--config NAME [--objects OBJECT_DIRECTORY (default: OBJECT_DIRECTORY/NAME)] [-o OUTPUT_FILE (default: OUTPUT_FILE-NAME)] [COMPILER_OPTIONS]]..." << std::endl;
 		return 0;
 	}
 
-	// Assert that arguments.source_directory exists and is a directory.
-	if (!std::filesystem::is_directory(arguments.source_directory)) {
-		return pgm::error(std::format("Source directory \"{}\" is not a directory. Create it or change it with the \"--source\" argument.", arguments.source_directory.string())).print();
+	pgm::project project(arguments, error);
+	if (error) {
+		return error.print();
 	}
 
-	// Assert that arguments.object_directory exists and is a directory.
-	if (!std::filesystem::is_directory(arguments.object_directory)) {
-		return pgm::error(std::format("Object directory \"{}\" is not a directory. Create it or change it with the \"--objects\" argument.", arguments.object_directory.string())).print();
+	// Writes the dependency graph of the first configuration from its manifest and prints the most expensive headers.
+	auto write_graph = [&arguments](const pgm::manifest &manifest, pgm::error &error) {
+		pgm::graph graph(manifest);
+		graph.save(arguments.graph, error);
+		if (!error) {
+			graph.print_ranking(std::cout, 10);
+		}
+	};
+
+	// Aggregates the compile time reports of every unit recorded in manifests, writes the profile and prints the most expensive headers and templates.
+	// Units that weren't compiled in this build still count with the report of their last profiled compile.
+	auto write_profile = [&arguments, &project](const std::vector<pgm::manifest> &manifests, pgm::error &error) {
+		pgm::profile profile;
+		for (std::vector<pgm::manifest>::size_type i = 0; i < manifests.size(); i++) {
+			for (std::uint32_t unit = 0; unit < manifests[i].unit_count() && !error; unit++) {
+				profile.add_unit(manifests[i].path_of(manifests[i].unit_object(unit)), project.compiler(i).is_clang(), error);
+			}
+		}
+		if (error) {
+			return;
+		}
+		profile.save(arguments.profile, error);
+		if (error) {
+			return;
+		}
+		if (profile.unit_count() == 0) {
+			std::cout << "No compile time reports found. Units are only profiled when they are compiled with \"--profile\" so remove their objects to profile them." << std::endl;
+			return;
+		}
+		profile.print_ranking(std::cout, 10);
+	};
+
+	// Prints the stored diagnostics of every unit recorded in manifests so warnings stay visible after their objects are up to date.
+	// Configurations often warn about the same line so each units diagnostics are only printed once.
+	auto replay_diagnostics = [](const std::vector<pgm::manifest> &manifests, pgm::error &error) {
+		std::unordered_set<std::string> printed;
+		for (const pgm::manifest &manifest : manifests) {
+			for (std::uint32_t unit = 0; unit < manifest.unit_count() && !error; unit++) {
+				std::string text;
+				for (const pgm::diagnostic &diagnostic : pgm::diagnostic::load(manifest.path_of(manifest.unit_object(unit)), error)) {
+					text += diagnostic.render();
+				}
+				if (!text.empty() && printed.insert(text).second) {
+					std::cerr << text;
+				}
+			}
+		}
+		std::cerr << std::flush;
+	};
+
+	pgm::project::callbacks callbacks;
+	// The link time optimization cost is printed apart from the link because it's the part "--lto" trades for faster executables.
+	if (arguments.lto) {
+		callbacks.optimized = [&arguments](std::size_t configuration, std::chrono::steady_clock::duration optimized, std::size_t processes) {
+			std::cout << std::format("Link time optimization of \"{}\" took {:.3f}s in {} processes.", arguments.configurations[configuration].out_file.string(), std::chrono::duration<double>(optimized).count(), processes) << std::endl;
+		};
 	}
 
-	// Find translation units.
-	std::vector<pgm::translation_unit> units = pgm::translation_unit::find_all(arguments.source_directory, arguments.object_directory, error);
+	// Link shards compiled elsewhere. Nothing is compiled.
+	if (!arguments.merge.empty()) {
+		project.merge(callbacks, error);
+		if (error) {
+			return error.print();
+		}
+		return 0;
+	}
+
+	// Fast path: if every file recorded by the last successful build is unchanged then there is nothing to do.
+	if (project.up_to_date()) {
+		replay_diagnostics(project.recorded(), error);
+		if (error) {
+			return error.print();
+		}
+		if (arguments.explain) {
+			std::cout << "Nothing to rebuild: no file recorded by the last build changed." << std::endl;
+		}
+		if (!arguments.graph.empty()) {
+			write_graph(project.recorded()[0], error);
+			if (error) {
+				return error.print();
+			}
+		}
+		if (!arguments.profile.empty()) {
+			write_profile(project.recorded(), error);
+			if (error) {
+				return error.print();
+			}
+		}
+		return 0;
+	}
+
+	std::vector<pgm::project::unit> outdated = project.outdated(error);
 	if (error) {
 		return error.print();
 	}
 
-	// Compiler.
-	pgm::compiler compiler(arguments.compiler, arguments.compiler_arguments);
+	// With "--explain", why each unit is compiled and the causes of each configurations link.
+	std::vector<std::vector<std::string>> link_causes(arguments.configurations.size());
+	if (arguments.explain) {
+		for (const pgm::project::unit &unit : outdated) {
+			const std::string &name = arguments.configurations[unit.configuration].name;
+			std::cout << std::format("Recompiling \"{}\"{}: {}", unit.source.string(), name.empty() ? "" : " (" + name + ")", unit.trigger.detail) << std::endl;
+			link_causes[unit.configuration].push_back(unit.trigger.cause);
+		}
+	}
+
+	// Time each trigger cost, by cause.
+	class cost {
+		public:
+		std::size_t units = 0;
+		std::chrono::steady_clock::duration scan{};
+		std::chrono::steady_clock::duration compile{};
+		std::chrono::steady_clock::duration link{};
+	};
+	std::map<std::string, cost> costs;
+	if (arguments.explain) {
+		callbacks.finished = [&costs](const pgm::project::unit &unit, bool, std::chrono::steady_clock::duration duration) {
+			cost &cost = costs[unit.trigger.cause];
+			cost.units++;
+			cost.scan += unit.trigger.scan_time;
+			cost.compile += duration;
+		};
+		// Every cause that made a configuration recompile is equally responsible for its link.
+		callbacks.linked = [&costs, &link_causes](std::size_t configuration, std::chrono::steady_clock::duration link_time) {
+			std::vector<std::string> &causes = link_causes[configuration];
+			std::sort(causes.begin(), causes.end());
+			causes.erase(std::unique(causes.begin(), causes.end()), causes.end());
+			if (causes.empty()) {
+				causes.push_back("relinked without recompiling");
+			}
+			for (const std::string &cause : causes) {
+				costs[cause].link += link_time / static_cast<long>(causes.size());
+			}
+		};
+	}
 
-	// Find units that have changed.
-	std::vector<pgm::translation_unit> changed_units = pgm::translation_unit::find_changed(units, compiler, error);
+	// Compile objects of all configurations through one pool, then link.
+	project.compile(outdated, callbacks, error);
+	if (error) {
+		return error.print();
+	}
+	project.link(callbacks, error);
 	if (error) {
 		return error.print();
 	}
 
-	// Compile objects.
-	// This should be parallelised.
-	for (const pgm::translation_unit &unit : changed_units) {
-		compiler.compile(unit, error);
+	// The manifests just recorded list every unit of this build.
+	const std::vector<pgm::manifest> &recorded = project.recorded();
+	replay_diagnostics(recorded, error);
+	if (error) {
+		return error.print();
+	}
+
+	if (!arguments.graph.empty()) {
+		write_graph(recorded[0], error);
 		if (error) {
 			return error.print();
 		}
 	}
 
-	// Link.
-	if (units.size() > 0) {
-		compiler.link(units, arguments.out_file, error);
+	if (!arguments.profile.empty()) {
+		write_profile(recorded, error);
 		if (error) {
 			return error.print();
 		}
 	}
 
+	if (arguments.explain) {
+		// Most expensive cause first. That's the one worth fixing.
+		std::vector<std::pair<std::string, cost>> sorted_costs(costs.begin(), costs.end());
+		std::stable_sort(sorted_costs.begin(), sorted_costs.end(), [](const std::pair<std::string, cost> &a, const std::pair<std::string, cost> &b) {
+			return a.second.scan + a.second.compile + a.second.link > b.second.scan + b.second.compile + b.second.link;
+		});
+		auto seconds = [](std::chrono::steady_clock::duration duration) {
+			return std::format("{:.3f}s", std::chrono::duration<double>(duration).count());
+		};
+		std::cout << std::format("{:>6} {:>10} {:>10} {:>10}  {}", "units", "scan", "compile", "link", "cause") << std::endl;
+		for (const std::pair<std::string, cost> &cost : sorted_costs) {
+			std::cout << std::format("{:>6} {:>10} {:>10} {:>10}  {}", cost.second.units, seconds(cost.second.scan), seconds(cost.second.compile), seconds(cost.second.link), cost.first) << std::endl;
+		}
+	}
+
 	return 0;
 }
@@ -0,0 +1,399 @@
+#include "manifest.hpp"
+
+#include <format>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Identifies the file and its version. Change the version whenever the layout changes so old manifests are ignored.
+static constexpr char manifest_magic[16] = "cromple-mf v3";
+
+// Rounds size up to the 8 byte alignment every section starts at.
+static constexpr std::uint64_t
+align(std::uint64_t size) {
+	return (size + 7) & ~std::uint64_t(7);
+}
+
+pgm::manifest::writer::writer(std::uint64_t fingerprint) : fingerprint{fingerprint} {}
+
+std::uint32_t
+pgm::manifest::writer::intern(std::string_view path) {
+	auto [iterator, inserted] = path_ids.try_emplace(std::string(path), static_cast<std::uint32_t>(paths.size()));
+	if (inserted) {
+		paths.emplace_back(path);
+		files.push_back(manifest::stat(paths.back()));
+	}
+	return iterator->second;
+}
+
+const pgm::manifest::file &
+pgm::manifest::writer::file_of(std::uint32_t path) const {
+	return files[path];
+}
+
+void
+pgm::manifest::writer::set_source_directory(std::string_view path) {
+	source_directory = intern(path);
+}
+
+void
+pgm::manifest::writer::set_out_file(std::string_view path) {
+	out_file = intern(path);
+}
+
+void
+pgm::manifest::writer::add_unit(std::string_view root_path, std::string_view object_path, std::uint64_t fingerprint, std::uint64_t compile_time, const std::vector<std::uint32_t> &prerequisites) {
+	units.push_back({intern(root_path), intern(object_path), fingerprint, compile_time, prerequisites});
+}
+
+void
+pgm::manifest::writer::save(const std::filesystem::path &path, error &error) const {
+	// Sort units by root path so manifest::find can binary search.
+	std::vector<const unit *> sorted_units;
+	for (const unit &unit : units) {
+		sorted_units.push_back(&unit);
+	}
+	std::sort(sorted_units.begin(), sorted_units.end(), [this](const unit *a, const unit *b) {
+		return paths[a->root_path] < paths[b->root_path];
+	});
+
+	std::string buffer;
+	auto append = [&buffer](const void *data, std::size_t size) {
+		buffer.append(static_cast<const char *>(data), size);
+	};
+	auto pad = [&buffer]() {
+		buffer.resize(align(buffer.size()), '\0');
+	};
+
+	header_record header{};
+	std::memcpy(header.magic, manifest_magic, sizeof(header.magic));
+	header.fingerprint = fingerprint;
+	header.path_count = static_cast<std::uint32_t>(paths.size());
+	header.unit_count = static_cast<std::uint32_t>(units.size());
+	header.source_directory = source_directory;
+	header.out_file = out_file;
+	for (const unit &unit : units) {
+		header.adjacency_count += unit.prerequisites.size();
+	}
+	for (const std::string &path : paths) {
+		header.string_bytes += path.size();
+	}
+	append(&header, sizeof(header));
+	pad();
+
+	// Path columns.
+	std::uint64_t offset = 0;
+	for (const std::string &path : paths) {
+		append(&offset, sizeof(offset));
+		offset += path.size();
+	}
+	for (const file &file : files) {
+		append(&file.modified, sizeof(file.modified));
+	}
+	for (const file &file : files) {
+		append(&file.inode, sizeof(file.inode));
+	}
+	for (const std::string &path : paths) {
+		std::uint32_t length = static_cast<std::uint32_t>(path.size());
+		append(&length, sizeof(length));
+	}
+	pad();
+
+	// Units and their prerequisite ranges.
+	std::uint64_t first_prerequisite = 0;
+	for (const unit *unit : sorted_units) {
+		unit_record record{unit->root_path, unit->object_path, unit->fingerprint, first_prerequisite, unit->prerequisites.size(), unit->compile_time};
+		append(&record, sizeof(record));
+		first_prerequisite += unit->prerequisites.size();
+	}
+	for (const unit *unit : sorted_units) {
+		append(unit->prerequisites.data(), unit->prerequisites.size() * sizeof(std::uint32_t));
+	}
+	pad();
+
+	for (const std::string &path : paths) {
+		buffer += path;
+	}
+
+	std::filesystem::path temporary_path = path;
+	temporary_path += ".tmp";
+	do {
+		{
+			std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+			stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			if (!stream) {
+				error.append(std::format("Error writing \"{}\".", temporary_path.string()));
+				break;
+			}
+		}
+
+		// Rename is atomic so readers see either the old or the new manifest.
+		std::error_code error_code;
+		std::filesystem::rename(temporary_path, path, error_code);
+		if (error_code) {
+			error.append(error_code.message());
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append(std::format("Error saving manifest \"{}\".", path.string()));
+}
+
+pgm::manifest::manifest() {}
+
+pgm::manifest::manifest(manifest &&other) {
+	*this = std::move(other);
+}
+
+pgm::manifest &
+pgm::manifest::operator=(manifest &&other) {
+	if (this == &other) {
+		return *this;
+	}
+	if (mapping != nullptr) {
+		::munmap(const_cast<char *>(mapping), mapping_size);
+	}
+	mapping = std::exchange(other.mapping, nullptr);
+	mapping_size = std::exchange(other.mapping_size, 0);
+	header = std::exchange(other.header, nullptr);
+	path_offsets = std::exchange(other.path_offsets, {});
+	path_modified = std::exchange(other.path_modified, {});
+	path_inodes = std::exchange(other.path_inodes, {});
+	path_lengths = std::exchange(other.path_lengths, {});
+	units = std::exchange(other.units, {});
+	adjacency = std::exchange(other.adjacency, {});
+	strings = std::exchange(other.strings, {});
+	return *this;
+}
+
+pgm::manifest::~manifest() {
+	if (mapping != nullptr) {
+		::munmap(const_cast<char *>(mapping), mapping_size);
+	}
+}
+
+std::filesystem::path
+pgm::manifest::path(const std::filesystem::path &object_directory) {
+	return object_directory / "cromple.manifest";
+}
+
+pgm::manifest
+pgm::manifest::load(const std::filesystem::path &path) {
+	int file_descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file_descriptor == -1) {
+		return pgm::manifest();
+	}
+	struct stat status;
+	if (::fstat(file_descriptor, &status) == -1 || static_cast<std::size_t>(status.st_size) < sizeof(header_record)) {
+		::close(file_descriptor);
+		return pgm::manifest();
+	}
+	std::size_t size = static_cast<std::size_t>(status.st_size);
+	void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	::close(file_descriptor);
+	if (mapping == MAP_FAILED) {
+		return pgm::manifest();
+	}
+
+	// From here the mapping belongs to manifest so returning an empty manifest() unmaps it.
+	pgm::manifest manifest;
+	manifest.mapping = static_cast<const char *>(mapping);
+	manifest.mapping_size = size;
+
+	const header_record *header = reinterpret_cast<const header_record *>(manifest.mapping);
+	if (std::memcmp(header->magic, manifest_magic, sizeof(manifest_magic)) != 0) {
+		return pgm::manifest();
+	}
+	// Only section sizes are checked here so loading doesn't grow with the tree. Ids are bounds checked when they are used.
+	if (header->adjacency_count > size || header->string_bytes > size) {
+		return pgm::manifest();
+	}
+	std::uint64_t paths = header->path_count;
+	std::uint64_t offset = align(sizeof(header_record));
+	std::uint64_t path_offsets = offset;
+	offset += paths * sizeof(std::uint64_t);
+	std::uint64_t path_modified = offset;
+	offset += paths * sizeof(std::int64_t);
+	std::uint64_t path_inodes = offset;
+	offset += paths * sizeof(std::uint64_t);
+	std::uint64_t path_lengths = offset;
+	offset = align(offset + paths * sizeof(std::uint32_t));
+	std::uint64_t units = offset;
+	offset += header->unit_count * sizeof(unit_record);
+	std::uint64_t adjacency = offset;
+	offset = align(offset + header->adjacency_count * sizeof(std::uint32_t));
+	std::uint64_t strings = offset;
+	offset += header->string_bytes;
+	if (offset != size) {
+		return pgm::manifest();
+	}
+
+	const char *base = manifest.mapping;
+	manifest.header = header;
+	manifest.path_offsets = {reinterpret_cast<const std::uint64_t *>(base + path_offsets), paths};
+	manifest.path_modified = {reinterpret_cast<const std::int64_t *>(base + path_modified), paths};
+	manifest.path_inodes = {reinterpret_cast<const std::uint64_t *>(base + path_inodes), paths};
+	manifest.path_lengths = {reinterpret_cast<const std::uint32_t *>(base + path_lengths), paths};
+	manifest.units = {reinterpret_cast<const unit_record *>(base + units), header->unit_count};
+	manifest.adjacency = {reinterpret_cast<const std::uint32_t *>(base + adjacency), header->adjacency_count};
+	manifest.strings = {base + strings, header->string_bytes};
+	return manifest;
+}
+
+bool
+pgm::manifest::record(writer &writer, const manifest &previous, const std::filesystem::path &source_directory, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &out_file, const std::unordered_map<std::string, std::uint64_t> &compile_times, pgm::scanner &scanner, const std::vector<std::filesystem::path> &outputs, error &error) {
+	writer.set_source_directory(source_directory.string());
+	std::uint32_t out_file_id = writer.intern(out_file.string());
+	writer.set_out_file(out_file.string());
+	const file out_file_state = writer.file_of(out_file_id);
+
+	// Outputs belong to no unit. Interning them is enough for is_up_to_date to stat them.
+	for (const std::filesystem::path &output : outputs) {
+		if (writer.file_of(writer.intern(output.string())).modified == 0) {
+			return false;
+		}
+	}
+
+	for (const pgm::translation_unit &unit : units) {
+		std::uint32_t object = writer.intern(unit.object_path.string());
+		const file object_state = writer.file_of(object);
+		if (object_state.modified == 0 || object_state.modified > out_file_state.modified) {
+			return false;
+		}
+
+		std::vector<std::uint32_t> prerequisites;
+		std::uint64_t compile_time = 0;
+		std::unordered_map<std::string, std::uint64_t>::const_iterator measured = compile_times.find(unit.root_path.string());
+		if (measured != compile_times.end()) {
+			compile_time = measured->second;
+		}
+		std::uint32_t previous_unit = previous.find(unit.root_path);
+		std::uint32_t previous_object = previous_unit == no_unit ? 0 : previous.unit_object(previous_unit);
+		if (previous_unit != no_unit && previous.path_of(previous_object) == unit.object_path.string() && previous.file_of(previous_object) == object_state) {
+			// Not recompiled since the previous manifest so its prerequisites and compile time are the same.
+			if (measured == compile_times.end()) {
+				compile_time = previous.unit_compile_time(previous_unit);
+			}
+			for (std::uint32_t prerequisite : previous.prerequisites(previous_unit)) {
+				prerequisites.push_back(writer.intern(previous.path_of(prerequisite)));
+			}
+		} else {
+			// Prefer the dependency file written by a compile during this build over what the scanner found before the build.
+			std::vector<std::string> paths;
+			if (!pgm::scanner::read_dependency_file(unit.dependency_path, paths)) {
+				paths = scanner.prerequisites(unit, error);
+				if (error) {
+					error.append(std::format("Error recording manifest entry for \"{}\".", unit.root_path.string()));
+					return false;
+				}
+			}
+			for (const std::string &path : paths) {
+				prerequisites.push_back(writer.intern(path));
+			}
+		}
+
+		for (std::uint32_t prerequisite : prerequisites) {
+			const file &state = writer.file_of(prerequisite);
+			if (state.modified == 0 || state.modified > object_state.modified) {
+				return false;
+			}
+		}
+		writer.add_unit(unit.root_path.string(), unit.object_path.string(), compiler.fingerprint(unit), compile_time, prerequisites);
+	}
+	return true;
+}
+
+bool
+pgm::manifest::is_up_to_date(std::uint64_t fingerprint) const {
+	if (header == nullptr || header->fingerprint != fingerprint) {
+		return false;
+	}
+	// Paths are interned so every file is stat'ed exactly once.
+	for (std::uint32_t path = 0; path < path_offsets.size(); path++) {
+		if (stat(std::string(path_of(path))) != file_of(path)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::uint32_t
+pgm::manifest::find(const std::filesystem::path &root_path) const {
+	const std::string root_path_string = root_path.string();
+	std::span<const unit_record>::iterator iterator = std::lower_bound(units.begin(), units.end(), root_path_string, [this](const unit_record &unit, const std::string &root_path) {
+		return path_of(unit.root_path) < root_path;
+	});
+	if (iterator == units.end() || path_of(iterator->root_path) != root_path_string) {
+		return no_unit;
+	}
+	return static_cast<std::uint32_t>(iterator - units.begin());
+}
+
+std::uint64_t
+pgm::manifest::unit_fingerprint(std::uint32_t unit) const {
+	return units[unit].fingerprint;
+}
+
+std::uint64_t
+pgm::manifest::unit_compile_time(std::uint32_t unit) const {
+	return units[unit].compile_time;
+}
+
+std::uint32_t
+pgm::manifest::unit_count() const {
+	return static_cast<std::uint32_t>(units.size());
+}
+
+std::uint32_t
+pgm::manifest::unit_source(std::uint32_t unit) const {
+	return units[unit].root_path;
+}
+
+std::uint32_t
+pgm::manifest::unit_object(std::uint32_t unit) const {
+	return units[unit].object_path;
+}
+
+std::span<const std::uint32_t>
+pgm::manifest::prerequisites(std::uint32_t unit) const {
+	const unit_record &record = units[unit];
+	if (record.first_prerequisite > adjacency.size() || record.prerequisite_count > adjacency.size() - record.first_prerequisite) {
+		return {};
+	}
+	return adjacency.subspan(record.first_prerequisite, record.prerequisite_count);
+}
+
+std::string_view
+pgm::manifest::path_of(std::uint32_t path) const {
+	if (path >= path_offsets.size() || path_offsets[path] > strings.size() || path_lengths[path] > strings.size() - path_offsets[path]) {
+		return {};
+	}
+	return strings.substr(path_offsets[path], path_lengths[path]);
+}
+
+pgm::manifest::file
+pgm::manifest::file_of(std::uint32_t path) const {
+	if (path >= path_offsets.size()) {
+		return file();
+	}
+	return {path_modified[path], path_inodes[path]};
+}
+
+pgm::manifest::file
+pgm::manifest::stat(const std::string &path) {
+	file file;
+	// statx only fetches the fields asked for and AT_STATX_DONT_SYNC avoids round trips on network filesystems.
+	struct statx buffer;
+	if (::statx(AT_FDCWD, path.c_str(), AT_STATX_DONT_SYNC, STATX_MTIME | STATX_INO, &buffer) == 0) {
+		file.modified = static_cast<std::int64_t>(buffer.stx_mtime.tv_sec) * 1000000000 + buffer.stx_mtime.tv_nsec;
+		file.inode = buffer.stx_ino;
+	}
+	return file;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+#include "error.hpp"
+#include "scanner.hpp"
+#include "compiler.hpp"
+#include "translation_unit.hpp"
+
+namespace pgm {
+	// Record of every file a successful build of one configuration read or wrote, with the modification time and inode they had.
+	// Stored in the objects directory. If a single pass of stat calls finds every file unchanged and the fingerprint matches then nothing needs doing and cromple exits without spawning anything.
+	// Also remembers the fingerprint each object was compiled with so changed flags cause a rebuild, and the prerequisites of each unit so unchanged units don't need scanning.
+	//
+	// The manifest is a binary file that is memory mapped read-only and queried in place. Loading it costs the same for 10 or 100k files; only the parts that are looked at are paged in.
+	// Paths are interned in one table so each file is stored and stat'ed once no matter how many units include it.
+	// Units refer to their prerequisites with ranges into one adjacency array of path ids.
+	// The file is in native byte order so it is not portable between machines with different byte order. It's only a cache.
+	// Updates are written with manifest::writer to a temporary file that is renamed over the old manifest.
+	class manifest {
+		public:
+		// State of a file when it was recorded or stat'ed.
+		class file {
+			public:
+			// Nanoseconds since the epoch. 0 when the file does not exist.
+			std::int64_t modified = 0;
+			std::uint64_t inode = 0;
+
+			bool
+			operator==(const file &other) const = default;
+		};
+
+		// Returned by find when a unit is not in the manifest.
+		static constexpr std::uint32_t no_unit = UINT32_MAX;
+
+		// Builds a new manifest in memory and saves it.
+		class writer {
+			public:
+			writer(std::uint64_t fingerprint);
+
+			// Returns the id of path in the path table, adding it and stat'ing it the first time it's seen.
+			std::uint32_t
+			intern(std::string_view path);
+
+			// State of path id when it was interned.
+			const file &
+			file_of(std::uint32_t path) const;
+
+			void
+			set_source_directory(std::string_view path);
+
+			void
+			set_out_file(std::string_view path);
+
+			void
+			add_unit(std::string_view root_path, std::string_view object_path, std::uint64_t fingerprint, std::uint64_t compile_time, const std::vector<std::uint32_t> &prerequisites);
+
+			// Writes to a temporary file and renames it over path.
+			void
+			save(const std::filesystem::path &path, error &error) const;
+
+			private:
+			class unit {
+				public:
+				std::uint32_t root_path;
+				std::uint32_t object_path;
+				std::uint64_t fingerprint;
+				std::uint64_t compile_time;
+				std::vector<std::uint32_t> prerequisites;
+			};
+
+			std::uint64_t fingerprint;
+			std::uint32_t source_directory = 0;
+			std::uint32_t out_file = 0;
+			std::vector<std::string> paths;
+			std::vector<file> files;
+			std::unordered_map<std::string, std::uint32_t> path_ids;
+			std::vector<unit> units;
+		};
+
+		// An empty manifest that is never up to date.
+		manifest();
+		manifest(manifest &&other);
+		manifest &
+		operator=(manifest &&other);
+		manifest(const manifest &) = delete;
+		manifest &
+		operator=(const manifest &) = delete;
+		~manifest();
+
+		// Path of the manifest in object_directory.
+		static std::filesystem::path
+		path(const std::filesystem::path &object_directory);
+
+		// Maps a manifest. A missing, damaged or old version manifest gives an empty manifest. It's only a cache so that is not an error.
+		static manifest
+		load(const std::filesystem::path &path);
+
+		// Builds the manifest of a configuration after it was successfully built.
+		// Prerequisites of units whose object did not change since previous was recorded are copied from previous. Others are read from their dependency file, or scanner as a last resort.
+		// compile_times has the nanoseconds each unit compiled in this build took, by source path. Units that weren't compiled keep the time from previous.
+		// outputs are other files the build wrote and needs next time, like BMIs. They are recorded with their state so is_up_to_date fails when one is deleted or replaced.
+		// Returns false if a file changed during the build, i.e. a prerequisite is newer than its object, an object is newer than out_file or an output is missing. Don't save the manifest then so a half stale build is never recorded as up to date.
+		static bool
+		record(writer &writer, const manifest &previous, const std::filesystem::path &source_directory, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &out_file, const std::unordered_map<std::string, std::uint64_t> &compile_times, pgm::scanner &scanner, const std::vector<std::filesystem::path> &outputs, error &error);
+
+		// Stats every recorded path once and checks that none of them changed and that fingerprint matches.
+		bool
+		is_up_to_date(std::uint64_t fingerprint) const;
+
+		// Returns the index of the unit with root_path or no_unit. Binary search in the mapped file.
+		std::uint32_t
+		find(const std::filesystem::path &root_path) const;
+
+		// compiler::fingerprint of the command the object of unit was compiled with.
+		std::uint64_t
+		unit_fingerprint(std::uint32_t unit) const;
+
+		// Nanoseconds the last compile of unit took. 0 when unknown.
+		std::uint64_t
+		unit_compile_time(std::uint32_t unit) const;
+
+		// Number of units.
+		std::uint32_t
+		unit_count() const;
+
+		// Path id of the source of unit.
+		std::uint32_t
+		unit_source(std::uint32_t unit) const;
+
+		// Path id of the object of unit.
+		std::uint32_t
+		unit_object(std::uint32_t unit) const;
+
+		// Path ids of the source and headers of unit.
+		std::span<const std::uint32_t>
+		prerequisites(std::uint32_t unit) const;
+
+		// Path with id path. Empty for invalid ids.
+		std::string_view
+		path_of(std::uint32_t path) const;
+
+		// Recorded state of path id. Default (never matching an existing file) for invalid ids.
+		file
+		file_of(std::uint32_t path) const;
+
+		// Current modification time and inode of path. modified is 0 when the file does not exist.
+		static file
+		stat(const std::string &path);
+
+		private:
+		// Layout of the file. Sections follow the header in this order, each starting 8 byte aligned:
+		// path_offsets (u64), path_modified (i64), path_inodes (u64), path_lengths (u32), units (unit_record), adjacency (u32), strings (chars).
+		class header_record {
+			public:
+			char magic[16];
+			std::uint64_t fingerprint;
+			std::uint64_t adjacency_count;
+			std::uint64_t string_bytes;
+			std::uint32_t path_count;
+			std::uint32_t unit_count;
+			std::uint32_t source_directory;
+			std::uint32_t out_file;
+		};
+
+		// Units are sorted by root path so find can binary search.
+		class unit_record {
+			public:
+			std::uint32_t root_path;
+			std::uint32_t object_path;
+			std::uint64_t fingerprint;
+			std::uint64_t first_prerequisite;
+			std::uint64_t prerequisite_count;
+			// Nanoseconds.
+			std::uint64_t compile_time;
+		};
+
+		// Whole mapped file. nullptr for an empty manifest.
+		const char *mapping = nullptr;
+		std::size_t mapping_size = 0;
+
+		// Views of the sections of mapping. Set by load.
+		const header_record *header = nullptr;
+		std::span<const std::uint64_t> path_offsets;
+		std::span<const std::int64_t> path_modified;
+		std::span<const std::uint64_t> path_inodes;
+		std::span<const std::uint32_t> path_lengths;
+		std::span<const unit_record> units;
+		std::span<const std::uint32_t> adjacency;
+		std::string_view strings;
+	};
+}
@@ -0,0 +1,330 @@
+#include "modules.hpp"
+
+#include <deque>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "json.hpp"
+#include "scanner.hpp"
+#include "process.hpp"
+
+// Paths of the scan of unit and of the make rule listing the files the scan read.
+static std::filesystem::path
+scan_path(const pgm::translation_unit &unit) {
+	std::filesystem::path path = unit.object_path;
+	path += ".ddi";
+	return path;
+}
+
+static std::filesystem::path
+scan_dependency_path(const pgm::translation_unit &unit) {
+	std::filesystem::path path = unit.object_path;
+	path += ".ddi.d";
+	return path;
+}
+
+// True if the scan of unit has to be repeated because it is missing, flags changed or a file it read is newer.
+static bool
+scan_is_outdated(const pgm::translation_unit &unit, const pgm::compiler &compiler, const pgm::manifest &manifest) {
+	pgm::manifest::file scan = pgm::manifest::stat(scan_path(unit).string());
+	if (scan.modified == 0) {
+		return true;
+	}
+	// Flags like -D can change which modules are imported.
+	std::uint32_t recorded = manifest.find(unit.root_path);
+	if (recorded != pgm::manifest::no_unit && manifest.unit_fingerprint(recorded) != compiler.fingerprint(unit)) {
+		return true;
+	}
+	std::vector<std::string> prerequisites;
+	if (!pgm::scanner::read_dependency_file(scan_dependency_path(unit), prerequisites)) {
+		return true;
+	}
+	for (const std::string &prerequisite : prerequisites) {
+		pgm::manifest::file file = pgm::manifest::stat(prerequisite);
+		if (file.modified == 0 || file.modified > scan.modified) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::filesystem::path
+pgm::modules::mapper_path(const std::filesystem::path &object_directory) {
+	return object_directory / "cromple.modules";
+}
+
+std::filesystem::path
+pgm::modules::bmi_path(const std::filesystem::path &object_directory, const std::string &module) {
+	// Partitions are called "module:partition" and colons are awkward in file names.
+	std::string file_name = module;
+	for (char &c : file_name) {
+		if (c == ':') {
+			c = '-';
+		}
+	}
+	return object_directory / "modules" / (file_name + ".gcm");
+}
+
+std::vector<std::filesystem::path>
+pgm::modules::bmi_paths(const std::filesystem::path &object_directory) const {
+	std::vector<std::filesystem::path> paths;
+	for (const std::pair<const std::string, std::size_t> &provider : providers) {
+		paths.push_back(bmi_path(object_directory, provider.first));
+	}
+	return paths;
+}
+
+void
+pgm::modules::scan(const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const pgm::manifest &manifest, const pgm::job_pool &pool, error &error) {
+	by_unit.assign(units.size(), {});
+	unit_indices.clear();
+	providers.clear();
+
+	do {
+		// Only C++ can have modules.
+		auto is_c = [](const pgm::translation_unit &unit) {
+			return unit.root_path.extension() == ".c";
+		};
+
+		std::vector<pgm::job_pool::job> jobs;
+		for (const pgm::translation_unit &unit : units) {
+			if (is_c(unit) || !scan_is_outdated(unit, compiler, manifest)) {
+				continue;
+			}
+			std::vector<std::string> command = compiler.module_scan_command(unit, scan_path(unit), scan_dependency_path(unit));
+			std::string command_string;
+			for (const std::string &part : command) {
+				command_string += " " + part;
+			}
+			pgm::job_pool::job &job = jobs.emplace_back();
+			job.description = std::format("Error scanning modules of source file \"{}\" with command \"{}\".", unit.root_path.string(), command_string);
+			job.start = [command](pgm::error &error) {
+				return process::exec(command, error);
+			};
+		}
+		pool.run(jobs, error);
+		if (error) {
+			break;
+		}
+
+		for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+			unit_indices.emplace(units[i].root_path, i);
+			if (is_c(units[i])) {
+				continue;
+			}
+			read_scan(scan_path(units[i]), by_unit[i], error);
+			if (error) {
+				error.append(std::format("Error reading modules of source file \"{}\".", units[i].root_path.string()));
+				break;
+			}
+			if (by_unit[i].provides.empty()) {
+				continue;
+			}
+			std::pair<std::unordered_map<std::string, std::size_t>::iterator, bool> inserted = providers.emplace(by_unit[i].provides, i);
+			if (!inserted.second) {
+				error.append(std::format("Module \"{}\" is provided by both \"{}\" and \"{}\".", by_unit[i].provides, units[inserted.first->second].root_path.string(), units[i].root_path.string()));
+				break;
+			}
+		}
+		if (error) {
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append("Error scanning module dependencies.");
+}
+
+void
+pgm::modules::write_mapper(const std::filesystem::path &object_directory, error &error) const {
+	std::filesystem::path path = mapper_path(object_directory);
+	do {
+		// BMI paths are absolute because GCC resolves relative ones against its own gcm.cache directory.
+		std::error_code error_code;
+		std::filesystem::path bmi_directory = std::filesystem::absolute(object_directory / "modules", error_code);
+		if (!error_code) {
+			std::filesystem::create_directories(bmi_directory, error_code);
+		}
+		if (error_code) {
+			error.append(error_code.message()).append(std::format("Error creating BMI directory \"{}\".", (object_directory / "modules").string()));
+			break;
+		}
+
+		// Sorted so the same modules always give the same file.
+		std::map<std::string, std::string> lines;
+		for (const std::pair<const std::string, std::size_t> &provider : providers) {
+			lines.emplace(provider.first, std::filesystem::absolute(bmi_path(object_directory, provider.first)).string());
+		}
+		std::string content;
+		for (const std::pair<const std::string, std::string> &line : lines) {
+			content += line.first + " " + line.second + "\n";
+		}
+
+		std::ifstream existing(path, std::ios::binary);
+		std::stringstream existing_content;
+		existing_content << existing.rdbuf();
+		if (existing && existing_content.str() == content) {
+			return;
+		}
+		existing.close();
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << content;
+		file.close();
+		if (!file) {
+			error.append(std::format("Error writing module mapper \"{}\".", path.string()));
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append("Error writing module mapper.");
+}
+
+std::vector<pgm::translation_unit>
+pgm::modules::add_importers(const std::vector<pgm::translation_unit> &units, const std::vector<pgm::translation_unit> &changed, const std::filesystem::path &object_directory) const {
+	std::vector<bool> rebuild(units.size(), false);
+	for (const pgm::translation_unit &unit : changed) {
+		std::map<std::filesystem::path, std::size_t>::const_iterator index = unit_indices.find(unit.root_path);
+		if (index != unit_indices.end()) {
+			rebuild[index->second] = true;
+		}
+	}
+
+	// Units that import each unit.
+	std::vector<std::vector<std::size_t>> importers(units.size());
+	for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+		if (!by_unit[i].provides.empty() && pgm::manifest::stat(bmi_path(object_directory, by_unit[i].provides).string()).modified == 0) {
+			rebuild[i] = true;
+		}
+		pgm::manifest::file object = pgm::manifest::stat(units[i].object_path.string());
+		for (const std::string &module : by_unit[i].imports) {
+			std::unordered_map<std::string, std::size_t>::const_iterator provider = providers.find(module);
+			// Modules that no unit provides (e.g. "std") come from the compiler. Compiling tells if they're really missing.
+			if (provider == providers.end()) {
+				continue;
+			}
+			importers[provider->second].push_back(i);
+			// A BMI newer than the object means an interface was rebuilt but this importer wasn't, e.g. because an earlier build was interrupted.
+			if (pgm::manifest::stat(bmi_path(object_directory, module).string()).modified > object.modified) {
+				rebuild[i] = true;
+			}
+		}
+	}
+
+	// Rebuilding an interface rewrites its BMI which invalidates everything that imports it, and in turn everything importing those.
+	std::deque<std::size_t> queue;
+	for (std::vector<bool>::size_type i = 0; i < rebuild.size(); i++) {
+		if (rebuild[i]) {
+			queue.push_back(i);
+		}
+	}
+	while (!queue.empty()) {
+		std::size_t index = queue.front();
+		queue.pop_front();
+		for (std::size_t importer : importers[index]) {
+			if (!rebuild[importer]) {
+				rebuild[importer] = true;
+				queue.push_back(importer);
+			}
+		}
+	}
+
+	std::vector<pgm::translation_unit> result;
+	for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+		if (rebuild[i]) {
+			result.push_back(units[i]);
+		}
+	}
+	return result;
+}
+
+std::vector<std::vector<std::size_t>>
+pgm::modules::dependencies(const std::vector<pgm::translation_unit> &changed) const {
+	// Position in changed of each unit, by index into by_unit.
+	std::unordered_map<std::size_t, std::size_t> positions;
+	for (std::vector<pgm::translation_unit>::size_type i = 0; i < changed.size(); i++) {
+		std::map<std::filesystem::path, std::size_t>::const_iterator index = unit_indices.find(changed[i].root_path);
+		if (index != unit_indices.end()) {
+			positions.emplace(index->second, i);
+		}
+	}
+
+	std::vector<std::vector<std::size_t>> dependencies(changed.size());
+	for (const std::pair<const std::size_t, std::size_t> &position : positions) {
+		for (const std::string &module : by_unit[position.first].imports) {
+			std::unordered_map<std::string, std::size_t>::const_iterator provider = providers.find(module);
+			if (provider == providers.end()) {
+				continue;
+			}
+			// Providers that are not rebuilt already have an up to date BMI.
+			std::unordered_map<std::size_t, std::size_t>::const_iterator provider_position = positions.find(provider->second);
+			if (provider_position != positions.end()) {
+				dependencies[position.second].push_back(provider_position->second);
+			}
+		}
+	}
+	return dependencies;
+}
+
+void
+pgm::modules::read_scan(const std::filesystem::path &path, unit_modules &modules, error &error) {
+	do {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			error.append(std::format("Error opening module scan \"{}\".", path.string()));
+			break;
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+
+		pgm::json document = pgm::json::parse(text.str(), error);
+		if (error) {
+			error.append(std::format("Error parsing module scan \"{}\".", path.string()));
+			break;
+		}
+
+		// P1689 has one rule per scanned source. Each rule lists the modules it "provides" and "requires" by "logical-name".
+		const pgm::json *rules = document.find("rules");
+		if (rules == nullptr || rules->kind != pgm::json::kind::array) {
+			error.append(std::format("Module scan \"{}\" has no \"rules\" array.", path.string()));
+			break;
+		}
+		auto logical_names = [&error, &path](const pgm::json &rule, std::string_view key, std::vector<std::string> &names) {
+			const pgm::json *modules = rule.find(key);
+			if (modules == nullptr) {
+				return;
+			}
+			for (const pgm::json &module : modules->elements) {
+				const pgm::json *name = module.find("logical-name");
+				if (name == nullptr || name->kind != pgm::json::kind::string) {
+					error.append(std::format("A module in \"{}\" of module scan \"{}\" has no \"logical-name\".", key, path.string()));
+					return;
+				}
+				// Header units ("import <header>;") are found by lookup method instead of by name and need BMIs of their own.
+				if (module.find("lookup-method") != nullptr) {
+					error.append(std::format("Header unit \"{}\" in module scan \"{}\" is not supported. Include the header instead.", name->string, path.string()));
+					return;
+				}
+				names.push_back(name->string);
+			}
+		};
+		std::vector<std::string> provides;
+		for (const pgm::json &rule : rules->elements) {
+			logical_names(rule, "provides", provides);
+			logical_names(rule, "requires", modules.imports);
+		}
+		if (error) {
+			break;
+		}
+		if (provides.size() > 1) {
+			error.append(std::format("Module scan \"{}\" provides more than one module.", path.string()));
+			break;
+		}
+		if (!provides.empty()) {
+			modules.provides = provides[0];
+		}
+		return;
+	} while (false);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+
+#include "error.hpp"
+#include "compiler.hpp"
+#include "job_pool.hpp"
+#include "manifest.hpp"
+#include "translation_unit.hpp"
+
+namespace pgm {
+	// C++20 module dependencies between the units of a build.
+	// Units can't be compiled in any order once they import modules: the unit that provides a module has to be compiled first because that writes the BMI (compiled module interface) importers read.
+	// Which unit provides and imports which module is scanned with the compiler (P1689 JSON) and cached next to each object as "OBJECT.ddi".
+	// BMIs are written to "OBJECTS_DIRECTORY/modules" through a module mapper file so they are tracked per configuration like objects are.
+	class modules {
+		public:
+		// Module interface provided and modules imported by one unit.
+		class unit_modules {
+			public:
+			// Empty for units that are not module interfaces.
+			std::string provides;
+			std::vector<std::string> imports;
+		};
+
+		// Path of the module mapper file of a configuration.
+		static std::filesystem::path
+		mapper_path(const std::filesystem::path &object_directory);
+
+		// Path of the BMI of module in a configuration.
+		static std::filesystem::path
+		bmi_path(const std::filesystem::path &object_directory, const std::string &module);
+
+		// Paths of the BMIs of every module provided by a unit in a configuration.
+		std::vector<std::filesystem::path>
+		bmi_paths(const std::filesystem::path &object_directory) const;
+
+		// Finds the modules of all units, scanning in parallel on pool the units whose last scan is outdated.
+		// units must be the units of the configuration compiler belongs to. Other configurations share the result because they build the same sources.
+		void
+		scan(const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const pgm::manifest &manifest, const pgm::job_pool &pool, error &error);
+
+		// Writes the module mapper of a configuration, mapping every module provided by a unit to its BMI.
+		// Left untouched when nothing changed.
+		void
+		write_mapper(const std::filesystem::path &object_directory, error &error) const;
+
+		// Returns changed plus the units that must be rebuilt because of modules, in the order of units:
+		// module interfaces whose BMI is missing and every unit that (indirectly) imports a module whose interface is rebuilt or whose BMI is newer than its object.
+		// Units that don't import a changed module are left alone.
+		std::vector<pgm::translation_unit>
+		add_importers(const std::vector<pgm::translation_unit> &units, const std::vector<pgm::translation_unit> &changed, const std::filesystem::path &object_directory) const;
+
+		// For each unit in changed, the indices into changed of the units that provide the modules it imports. Their compiles must finish first.
+		std::vector<std::vector<std::size_t>>
+		dependencies(const std::vector<pgm::translation_unit> &changed) const;
+
+		private:
+		// Modules of each unit. Same order as the units given to scan.
+		std::vector<unit_modules> by_unit;
+		// Index into by_unit of each units source.
+		std::map<std::filesystem::path, std::size_t> unit_indices;
+		// Index into by_unit of the unit that provides each module.
+		std::unordered_map<std::string, std::size_t> providers;
+
+		// Reads the P1689 scan at path into modules.
+		static void
+		read_scan(const std::filesystem::path &path, unit_modules &modules, error &error);
+	};
+}
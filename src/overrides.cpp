@@ -0,0 +1,57 @@
+#include "overrides.hpp"
+
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <fnmatch.h>
+
+pgm::overrides
+pgm::overrides::load(const std::filesystem::path &path, error &error) {
+	pgm::overrides overrides;
+	do {
+		std::ifstream file(path);
+		if (!file) {
+			error.append(std::format("Can't open \"{}\".", path.string()));
+			break;
+		}
+
+		std::string line;
+		std::size_t line_number = 0;
+		while (std::getline(file, line)) {
+			line_number++;
+			std::istringstream stream(line);
+			rule rule;
+			if (!(stream >> rule.glob) || rule.glob.starts_with('#')) {
+				continue;
+			}
+			std::string argument;
+			while (stream >> argument) {
+				rule.arguments.push_back(argument);
+			}
+			if (rule.arguments.empty()) {
+				error.append(std::format("Line {} \"{}\" has a glob but no compiler options.", line_number, line));
+				break;
+			}
+			overrides.rules.push_back(std::move(rule));
+		}
+		if (error) {
+			break;
+		}
+		return overrides;
+	} while (false);
+
+	error.append(std::format("Error loading compiler option overrides from \"{}\".", path.string()));
+	return pgm::overrides();
+}
+
+std::vector<std::string>
+pgm::overrides::arguments(const std::filesystem::path &source) const {
+	std::vector<std::string> arguments;
+	std::string name = source.filename().string();
+	for (const rule &rule : rules) {
+		if (fnmatch(rule.glob.c_str(), name.c_str(), 0) == 0) {
+			arguments.insert(arguments.end(), rule.arguments.begin(), rule.arguments.end());
+		}
+	}
+	return arguments;
+}
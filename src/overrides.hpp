@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "error.hpp"
+
+namespace pgm {
+	// Compiler options for some units only, read from the file given with "--overrides".
+	// Lets a project trade optimization for build time where it pays off, e.g. compile huge generated tables with -O1 while everything else gets -O3.
+	// Each line is a glob followed by the options for the sources whose file name matches it:
+	//
+	// # Generated tables take minutes with -O3.
+	// tables_*.cpp -O1 -g0
+	// embedded_*.cpp -DEMBEDDED_NO_CHECKS
+	//
+	// Options are separated by whitespace and can't be quoted. Lines starting with "#" and empty lines are skipped.
+	class overrides {
+		public:
+		class rule {
+			public:
+			// fnmatch pattern matched against the file name of a source. Sources are not searched recursively so the file name is all that tells them apart.
+			std::string glob;
+			std::vector<std::string> arguments;
+		};
+
+		// In the order of the file.
+		std::vector<rule> rules;
+
+		// Reads the rules in the file at path.
+		static overrides
+		load(const std::filesystem::path &path, error &error);
+
+		// Options of every rule matching source, in the order of the rules. Added after the configurations compiler options so later rules and overrides win where the compiler takes the last of conflicting options, like -O.
+		std::vector<std::string>
+		arguments(const std::filesystem::path &source) const;
+	};
+}
@@ -143,6 +143,15 @@ pgm::process::child::wait(error &error) const {
 	return info.si_status;
 }
 
+void
+pgm::process::child::close(error &error) const {
+	for (int file_descriptor : {stdin, stdout, stderr}) {
+		if (::close(file_descriptor) == -1) {
+			error.strerror().append(std::format("Error closing pipe \"{}\" of child process \"{}\".", file_descriptor, pid));
+		}
+	}
+}
+
 template<typename data_type>
 pgm::process::child
 pgm::process::fork(process::child_function<data_type> child_function, data_type data, error &error) {
@@ -212,6 +221,12 @@ pgm::process::fork(process::child_function<data_type> child_function, data_type
 	return process::child();
 }
 
+// fork is defined here so it needs explicit instantiations for use in other translation units.
+// void * lets callers pass any data, e.g. remote::run gets a pointer to its remote::job.
+template
+pgm::process::child
+pgm::process::fork<void *>(process::child_function<void *> child_function, void *data, error &error);
+
 pgm::process::child
 pgm::process::exec(std::vector<std::string> command_parts, error &error) {
 	process::child_function<std::vector<std::string>> child_function = [](std::vector<std::string> command_parts) {
@@ -68,6 +68,11 @@ namespace pgm {
 			// Waits for process to exit and returns the exit status.
 			int
 			wait(error &error) const;
+
+			// Closes the parents end of the stdin, stdout and stderr pipes.
+			// Call this once the child is no longer needed so long builds don't run out of file descriptors.
+			void
+			close(error &error) const;
 		};
 
 		template<typename data_type>
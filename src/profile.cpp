@@ -0,0 +1,224 @@
+#include "profile.hpp"
+
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+#include "json.hpp"
+#include "manifest.hpp"
+
+static std::string
+seconds(std::uint64_t nanoseconds) {
+	return std::format("{:.3f}", static_cast<double>(nanoseconds) / 1e9);
+}
+
+std::filesystem::path
+pgm::profile::report_path(const std::filesystem::path &object_path, bool time_trace) {
+	std::filesystem::path path = object_path;
+	if (time_trace) {
+		// Clang replaces the extension of the object, so "main.cpp.o" gets "main.cpp.json".
+		return path.replace_extension(".json");
+	}
+	path += ".time-report";
+	return path;
+}
+
+void
+pgm::profile::save_time_report(const std::filesystem::path &object_path, std::string_view report, error &error) {
+	std::filesystem::path path = report_path(object_path, false);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << report;
+	file.close();
+	if (!file) {
+		error.append(std::format("Error writing compile time report \"{}\".", path.string()));
+	}
+}
+
+void
+pgm::profile::add_unit(const std::filesystem::path &object_path, bool time_trace, error &error) {
+	std::filesystem::path path = report_path(object_path, time_trace);
+	pgm::manifest::file report = pgm::manifest::stat(path.string());
+	if (report.modified == 0 || report.modified < pgm::manifest::stat(object_path.string()).modified) {
+		return;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error.append(std::format("Error opening compile time report \"{}\".", path.string()));
+		return;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+
+	if (time_trace) {
+		add_time_trace(text.str(), error);
+		if (error) {
+			error.append(std::format("Error reading compile time trace \"{}\".", path.string()));
+		}
+		return;
+	}
+	add_time_report(text.str());
+}
+
+void
+pgm::profile::add_time_trace(std::string_view trace, error &error) {
+	do {
+		pgm::json document = pgm::json::parse(trace, error);
+		if (error) {
+			break;
+		}
+		const pgm::json *events = document.find("traceEvents");
+		if (events == nullptr || events->kind != pgm::json::kind::array) {
+			error.append("Trace has no \"traceEvents\" array.");
+			break;
+		}
+
+		// Complete events ("ph": "X") have a duration in microseconds. "Source" is the parsing of a header and the instantiations are named by their "detail".
+		// Clang also writes "Total ..." events that sum each event name over the unit. Those have no detail and are skipped.
+		for (const pgm::json &event : events->elements) {
+			const pgm::json *phase = event.find("ph");
+			const pgm::json *name = event.find("name");
+			const pgm::json *duration = event.find("dur");
+			const pgm::json *arguments = event.find("args");
+			const pgm::json *detail = arguments == nullptr ? nullptr : arguments->find("detail");
+			if (phase == nullptr || phase->string != "X" || name == nullptr || duration == nullptr || duration->kind != pgm::json::kind::number || detail == nullptr || detail->kind != pgm::json::kind::string) {
+				continue;
+			}
+			std::uint64_t time = static_cast<std::uint64_t>(duration->number * 1000);
+			if (name->string == "Source") {
+				add("header", detail->string, time);
+			} else if (name->string == "InstantiateClass" || name->string == "InstantiateFunction") {
+				add("template", detail->string, time);
+			}
+		}
+		units++;
+		return;
+	} while (false);
+
+	error.append("Error reading clang time trace.");
+}
+
+void
+pgm::profile::add_time_report(std::string_view report) {
+	// Lines of the table look like:
+	//  phase parsing                      :   0.60 ( 55%)   0.28 ( 85%)   0.90 ( 62%)    52M ( 66%)
+	//  |name lookup                       :   0.18 ( 16%)   0.01 (  3%)   0.15 ( 10%)  2308k (  3%)
+	// The columns are user, system and wall seconds, then memory. Percentages are in parentheses.
+	bool found = false;
+	std::string_view::size_type start = 0;
+	while (start < report.size()) {
+		std::string_view::size_type end = report.find('\n', start);
+		if (end == std::string_view::npos) {
+			end = report.size();
+		}
+		std::string_view line = report.substr(start, end - start);
+		start = end + 1;
+
+		std::string_view::size_type colon = line.find(" : ");
+		if (line.empty() || line[0] != ' ' || colon == std::string_view::npos) {
+			continue;
+		}
+
+		// "|" marks sub-timers that are also counted in the passes they happen in.
+		std::string_view name = line.substr(0, colon);
+		name.remove_prefix(std::min(name.find_first_not_of(" |"), name.size()));
+		name.remove_suffix(name.size() - (name.find_last_not_of(' ') + 1));
+		if (name.empty() || name == "TOTAL") {
+			continue;
+		}
+
+		// Collect the numbers outside parentheses.
+		std::vector<std::string> columns;
+		std::string column;
+		bool in_parentheses = false;
+		for (char c : line.substr(colon + 3)) {
+			if (c == '(' || c == ')') {
+				in_parentheses = c == '(';
+			}
+			if (in_parentheses || c == ')' || c == ' ') {
+				if (!column.empty()) {
+					columns.push_back(std::move(column));
+					column.clear();
+				}
+				continue;
+			}
+			column += c;
+		}
+		if (!column.empty()) {
+			columns.push_back(std::move(column));
+		}
+		if (columns.size() < 3) {
+			continue;
+		}
+		char *number_end = nullptr;
+		double wall = std::strtod(columns[2].c_str(), &number_end);
+		if (number_end != columns[2].c_str() + columns[2].size()) {
+			continue;
+		}
+
+		add(name.starts_with("phase ") ? "phase" : "pass", std::string(name), static_cast<std::uint64_t>(wall * 1e9));
+		found = true;
+	}
+	if (found) {
+		units++;
+	}
+}
+
+void
+pgm::profile::add(const std::string &kind, const std::string &name, std::uint64_t time) {
+	entry &entry = entries[{kind, name}];
+	entry.time += time;
+	entry.count++;
+}
+
+std::size_t
+pgm::profile::unit_count() const {
+	return units;
+}
+
+std::vector<pgm::profile::entry>
+pgm::profile::rank() const {
+	std::vector<entry> ranked;
+	ranked.reserve(entries.size());
+	for (const std::pair<const std::pair<std::string, std::string>, entry> &entry : entries) {
+		ranked.push_back(entry.second);
+		ranked.back().kind = entry.first.first;
+		ranked.back().name = entry.first.second;
+	}
+	// Stable so entries that took the same time stay sorted by kind and name.
+	std::stable_sort(ranked.begin(), ranked.end(), [](const entry &a, const entry &b) {
+		return a.time > b.time;
+	});
+	return ranked;
+}
+
+void
+pgm::profile::save(const std::filesystem::path &path, error &error) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		error.strerror().append(std::format("Error opening profile file \"{}\".", path.string()));
+		return;
+	}
+	file << "{\n\t\"units\": " << units << ",\n\t\"entries\": [";
+	std::vector<entry> ranked = rank();
+	for (std::vector<entry>::size_type i = 0; i < ranked.size(); i++) {
+		file << (i == 0 ? "\n" : ",\n");
+		file << "\t\t{\"kind\": " << pgm::json::quote(ranked[i].kind) << ", \"name\": " << pgm::json::quote(ranked[i].name) << ", \"seconds\": " << seconds(ranked[i].time) << ", \"count\": " << ranked[i].count << "}";
+	}
+	file << "\n\t]\n}\n";
+	file.close();
+	if (!file) {
+		error.append(std::format("Error writing profile file \"{}\".", path.string()));
+	}
+}
+
+void
+pgm::profile::print_ranking(std::ostream &stream, std::size_t count) const {
+	std::vector<entry> ranked = rank();
+	stream << std::format("{:>12} {:>8} {:>9}  {}", "time", "count", "kind", std::format("name (from {} units)", units)) << std::endl;
+	for (std::vector<entry>::size_type i = 0; i < ranked.size() && i < count; i++) {
+		stream << std::format("{:>12} {:>8} {:>9}  {}", seconds(ranked[i].time) + "s", ranked[i].count, ranked[i].kind, ranked[i].name) << std::endl;
+	}
+}
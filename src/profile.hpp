@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <filesystem>
+
+#include "error.hpp"
+
+namespace pgm {
+	// Compile time profile of a whole build, aggregated from the reports the compiler writes for each unit when compiling with profiling arguments.
+	// Clang writes a Chrome trace with "-ftime-trace" that times the parsing of every header and every template instantiation.
+	// GCC only prints a table of its passes with "-ftime-report" so it can tell that templates are slow but not which.
+	class profile {
+		public:
+		// Total time spent on one header, template or compiler pass over all units.
+		class entry {
+			public:
+			// "header", "template", "phase" or "pass".
+			std::string kind;
+			std::string name;
+			// Nanoseconds. Headers include the time of the headers they include and templates the instantiations they cause, like the compiler reports them.
+			std::uint64_t time = 0;
+			// Number of times the entry was reported, e.g. the number of units that parsed a header.
+			std::size_t count = 0;
+		};
+
+		// Path of the report of the unit compiled to object_path. Clang names its trace after the object and GCC's report is saved by cromple.
+		static std::filesystem::path
+		report_path(const std::filesystem::path &object_path, bool time_trace);
+
+		// Saves the table GCC printed to stderr while compiling to object_path, so later builds can still add it.
+		static void
+		save_time_report(const std::filesystem::path &object_path, std::string_view report, error &error);
+
+		// Adds the report of the unit compiled to object_path if there is one that is at least as new as the object.
+		// Older reports were written by an earlier compile and don't describe the object anymore.
+		void
+		add_unit(const std::filesystem::path &object_path, bool time_trace, error &error);
+
+		// Adds a Chrome trace written by clang with "-ftime-trace".
+		void
+		add_time_trace(std::string_view trace, error &error);
+
+		// Adds the table GCC prints to stderr with "-ftime-report". Other lines, like warnings, are ignored.
+		void
+		add_time_report(std::string_view report);
+
+		// Number of reports added.
+		std::size_t
+		unit_count() const;
+
+		// Entries ranked by time, most expensive first.
+		std::vector<entry>
+		rank() const;
+
+		// Writes the ranking to path as JSON.
+		void
+		save(const std::filesystem::path &path, error &error) const;
+
+		// Prints the count most expensive entries as a table.
+		void
+		print_ranking(std::ostream &stream, std::size_t count) const;
+
+		private:
+		// Indexed by kind and name.
+		std::map<std::pair<std::string, std::string>, entry> entries;
+		std::size_t units = 0;
+
+		void
+		add(const std::string &kind, const std::string &name, std::uint64_t time);
+	};
+}
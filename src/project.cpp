@@ -0,0 +1,489 @@
+#include "project.hpp"
+
+#include <atomic>
+#include <format>
+#include <unordered_map>
+
+#include "job_pool.hpp"
+#include "profile.hpp"
+#include "shard.hpp"
+#include "compiler.hpp"
+#include "scanner.hpp"
+#include "manifest.hpp"
+#include "modules.hpp"
+#include "generators.hpp"
+
+class pgm::project::implementation {
+	public:
+	// Never resized after construction because the scanner and modules refer to elements.
+	std::vector<pgm::compiler> compilers;
+	std::vector<pgm::manifest> manifests;
+	// Whether compilers[i].detect_diagnostics_format and detect_lto_cache were run.
+	std::vector<bool> diagnostics_detected;
+	std::vector<bool> lto_cache_detected;
+	// Found by outdated.
+	std::vector<std::vector<pgm::translation_unit>> units_by_configuration;
+	std::unique_ptr<pgm::scanner> scanner;
+	pgm::modules modules;
+	// Empty without "--generators".
+	pgm::generators generators;
+	// Nanoseconds each unit compiled by compile took, by configuration and source, until link records them.
+	std::vector<std::unordered_map<std::string, std::uint64_t>> compile_times;
+	// Loaded from "--shard-costs". Empty otherwise.
+	pgm::manifest shard_costs;
+	std::atomic<bool> cancelled = false;
+};
+
+pgm::project::project(const pgm::arguments &arguments, error &error) : arguments{arguments}, internals{std::make_unique<implementation>()} {
+	do {
+		// Assert that arguments.source_directory exists and is a directory.
+		if (!std::filesystem::is_directory(arguments.source_directory)) {
+			error.append(std::format("Source directory \"{}\" is not a directory. Create it or change it with the \"--source\" argument.", arguments.source_directory.string()));
+			break;
+		}
+
+		for (const pgm::arguments::configuration &configuration : arguments.configurations) {
+			// Named configurations default to a subdirectory of the objects directory so create it if only that subdirectory is missing.
+			if (!configuration.name.empty() && std::filesystem::is_directory(configuration.object_directory.parent_path())) {
+				std::error_code error_code;
+				std::filesystem::create_directory(configuration.object_directory, error_code);
+			}
+
+			// Assert that configuration.object_directory exists and is a directory.
+			if (!std::filesystem::is_directory(configuration.object_directory)) {
+				error.append(std::format("Object directory \"{}\" is not a directory. Create it or change it with the \"--objects\" argument.", configuration.object_directory.string()));
+				break;
+			}
+
+			// Configurations sharing an objects directory would overwrite each others objects.
+			for (const pgm::arguments::configuration &other : arguments.configurations) {
+				if (&other != &configuration && std::filesystem::equivalent(other.object_directory, configuration.object_directory)) {
+					error.append(std::format("Configurations \"{}\" and \"{}\" share object directory \"{}\". Give each configuration its own \"--objects\".", configuration.name, other.name, configuration.object_directory.string()));
+					break;
+				}
+			}
+			if (error) {
+				break;
+			}
+		}
+		if (error) {
+			break;
+		}
+
+		pgm::overrides overrides;
+		if (!arguments.overrides.empty()) {
+			overrides = pgm::overrides::load(arguments.overrides, error);
+			if (error) {
+				break;
+			}
+		}
+
+		if (!arguments.generators.empty()) {
+			internals->generators = pgm::generators::load(arguments.generators, error);
+			if (error) {
+				break;
+			}
+		}
+
+		// Shards that don't read the same costs would split differently so a costs file that can't be read is an error, not an empty manifest.
+		if (!arguments.shard_costs.empty()) {
+			internals->shard_costs = pgm::manifest::load(arguments.shard_costs);
+			if (internals->shard_costs.unit_count() == 0) {
+				error.append(std::format("Shard costs \"{}\" is missing, damaged, from another version of cromple or records no units. Give every shard the \"cromple.manifest\" of the same earlier build.", arguments.shard_costs.string()));
+				break;
+			}
+		}
+
+		internals->compilers.reserve(arguments.configurations.size());
+		for (const pgm::arguments::configuration &configuration : arguments.configurations) {
+			internals->compilers.emplace_back(arguments.compiler, configuration.compiler_arguments, arguments.workers, arguments.worker_timeout);
+			if (arguments.modules) {
+				internals->compilers.back().set_module_mapper(pgm::modules::mapper_path(configuration.object_directory));
+			}
+			if (!arguments.profile.empty()) {
+				internals->compilers.back().set_profiling();
+			}
+			internals->compilers.back().set_overrides(overrides);
+			if (arguments.lto) {
+				internals->compilers.back().set_lto(configuration.object_directory / "lto-cache");
+			}
+			internals->manifests.push_back(pgm::manifest::load(pgm::manifest::path(configuration.object_directory)));
+		}
+		internals->diagnostics_detected.assign(internals->compilers.size(), false);
+		internals->lto_cache_detected.assign(internals->compilers.size(), false);
+		internals->compile_times.resize(internals->compilers.size());
+		return;
+	} while (false);
+
+	error.append("Error loading project.");
+}
+
+pgm::project::~project() = default;
+
+const std::vector<pgm::manifest> &
+pgm::project::recorded() const {
+	return internals->manifests;
+}
+
+const pgm::compiler &
+pgm::project::compiler(std::size_t configuration) const {
+	return internals->compilers[configuration];
+}
+
+bool
+pgm::project::up_to_date() const {
+	// The manifest is of a full build, not of a shard.
+	if (arguments.shard_count > 0) {
+		return false;
+	}
+	// Generator inputs are not in the manifest.
+	if (!internals->generators.up_to_date(arguments.configurations[0].object_directory)) {
+		return false;
+	}
+	for (std::vector<pgm::compiler>::size_type i = 0; i < internals->compilers.size(); i++) {
+		if (!internals->manifests[i].is_up_to_date(internals->compilers[i].fingerprint(arguments.configurations[i].out_file))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+pgm::project::find_units(error &error) {
+	do {
+		// The source directory is only walked once. Other configurations get the same sources with their own object paths.
+		internals->units_by_configuration.clear();
+		internals->units_by_configuration.push_back(pgm::translation_unit::find_all(arguments.source_directory, arguments.configurations[0].object_directory, error, internals->generators.outputs()));
+		if (error) {
+			break;
+		}
+		for (std::vector<pgm::arguments::configuration>::size_type i = 1; i < arguments.configurations.size(); i++) {
+			std::vector<pgm::translation_unit> &units = internals->units_by_configuration.emplace_back();
+			for (const pgm::translation_unit &unit : internals->units_by_configuration[0]) {
+				units.emplace_back(unit.root_path, arguments.configurations[i].object_directory);
+			}
+		}
+		if (arguments.shard_count > 0) {
+			for (std::vector<pgm::arguments::configuration>::size_type i = 0; i < arguments.configurations.size(); i++) {
+				internals->units_by_configuration[i] = pgm::shard::select(internals->units_by_configuration[i], internals->shard_costs, arguments.shard_index, arguments.shard_count);
+			}
+		}
+
+		// The header graph is the same for all configurations so one scanner using the first configurations flags serves them all.
+		// A new scanner each time because it remembers what it scanned and headers may have changed since the last call.
+		internals->scanner = std::make_unique<pgm::scanner>(internals->compilers[0], arguments.scanner, arguments.configurations[0].compiler_arguments);
+		for (const pgm::manifest &manifest : internals->manifests) {
+			internals->scanner->add_manifest(manifest);
+		}
+		return;
+	} while (false);
+
+	internals->units_by_configuration.clear();
+	error.append(std::format("Error finding translation units in source directory \"{}\".", arguments.source_directory.string()));
+}
+
+std::vector<pgm::project::unit>
+pgm::project::outdated(error &error) {
+	std::vector<unit> outdated_units;
+	do {
+		// Generated sources and headers have to be there before anything is scanned.
+		// Their state is kept with the first configuration because all configurations share the generated files.
+		if (check_cancelled(error)) {
+			break;
+		}
+		internals->generators.run(arguments.configurations[0].object_directory, pgm::job_pool(arguments.jobs), &internals->cancelled, error);
+		internals->cancelled = false;
+		if (error) {
+			break;
+		}
+
+		find_units(error);
+		if (error) {
+			break;
+		}
+
+		// Find which units provide and import which modules. Module interfaces are the same for all configurations so the sources are only scanned once.
+		if (arguments.modules) {
+			pgm::job_pool job_pool(arguments.jobs);
+			internals->modules.scan(internals->units_by_configuration[0], internals->compilers[0], internals->manifests[0], job_pool, error);
+			for (const pgm::arguments::configuration &configuration : arguments.configurations) {
+				internals->modules.write_mapper(configuration.object_directory, error);
+			}
+			if (error) {
+				break;
+			}
+		}
+
+		for (std::vector<pgm::compiler>::size_type i = 0; i < internals->compilers.size(); i++) {
+			std::vector<pgm::translation_unit::trigger> triggers;
+			std::vector<pgm::translation_unit> changed_units = pgm::translation_unit::find_changed(internals->units_by_configuration[i], *internals->scanner, internals->compilers[i], internals->manifests[i], error, &triggers);
+			if (error) {
+				break;
+			}
+
+			// Importers of rebuilt module interfaces are rebuilt too.
+			if (arguments.modules) {
+				std::vector<pgm::translation_unit> module_changed_units = internals->modules.add_importers(internals->units_by_configuration[i], changed_units, arguments.configurations[i].object_directory);
+				// Units added by add_importers keep the order of units so merge the triggers found so far in by source.
+				std::vector<pgm::translation_unit::trigger> module_triggers;
+				std::vector<pgm::translation_unit>::size_type next = 0;
+				for (const pgm::translation_unit &unit : module_changed_units) {
+					if (next < changed_units.size() && changed_units[next].root_path == unit.root_path) {
+						module_triggers.push_back(std::move(triggers[next++]));
+						continue;
+					}
+					pgm::translation_unit::trigger &trigger = module_triggers.emplace_back();
+					trigger.cause = "imported module rebuilt";
+					trigger.detail = "imports a module whose interface is recompiled, or whose BMI is newer than the object or missing.";
+				}
+				triggers = std::move(module_triggers);
+				changed_units = std::move(module_changed_units);
+			}
+
+			for (std::vector<pgm::translation_unit>::size_type j = 0; j < changed_units.size(); j++) {
+				outdated_units.push_back({i, changed_units[j].root_path, changed_units[j].object_path, std::move(triggers[j])});
+			}
+		}
+		if (error) {
+			break;
+		}
+		return outdated_units;
+	} while (false);
+
+	error.append("Error finding outdated units.");
+	return std::vector<unit>();
+}
+
+void
+pgm::project::compile(const std::vector<unit> &units, const callbacks &callbacks, error &error) {
+	do {
+		if (check_cancelled(error)) {
+			break;
+		}
+
+		// Units as the compiler and modules know them, by configuration, and the jobs compiling them.
+		std::vector<std::vector<pgm::translation_unit>> units_to_compile(internals->compilers.size());
+		std::vector<std::vector<std::vector<unit>::size_type>> indices(internals->compilers.size());
+		for (std::vector<unit>::size_type i = 0; i < units.size(); i++) {
+			units_to_compile[units[i].configuration].emplace_back(units[i].source, arguments.configurations[units[i].configuration].object_directory);
+			indices[units[i].configuration].push_back(i);
+		}
+
+		std::vector<pgm::job_pool::job> jobs;
+		std::vector<std::vector<unit>::size_type> job_units;
+		for (std::vector<pgm::compiler>::size_type i = 0; i < internals->compilers.size(); i++) {
+			if (units_to_compile[i].empty()) {
+				continue;
+			}
+			if (!internals->diagnostics_detected[i]) {
+				internals->compilers[i].detect_diagnostics_format(error);
+				if (error) {
+					break;
+				}
+				internals->diagnostics_detected[i] = true;
+			}
+
+			// Importers of module interfaces wait for them.
+			std::vector<std::vector<std::size_t>> dependencies(units_to_compile[i].size());
+			if (arguments.modules) {
+				dependencies = internals->modules.dependencies(units_to_compile[i]);
+			}
+			std::size_t first_job = jobs.size();
+			for (std::vector<pgm::translation_unit>::size_type j = 0; j < units_to_compile[i].size(); j++) {
+				pgm::job_pool::job &job = jobs.emplace_back(internals->compilers[i].compile_job(units_to_compile[i][j]));
+				const unit &unit = units[indices[i][j]];
+				job_units.push_back(indices[i][j]);
+				for (std::size_t dependency : dependencies[j]) {
+					job.dependencies.push_back(first_job + dependency);
+				}
+				if (callbacks.started) {
+					job.started = [&callbacks, &unit](const pgm::job_pool::job &) {
+						callbacks.started(unit);
+					};
+				}
+				if (callbacks.finished) {
+					job.finished = [&callbacks, &unit](const pgm::job_pool::job &job) {
+						callbacks.finished(unit, job.exit_status == 0, job.duration);
+					};
+				}
+			}
+		}
+		if (error) {
+			break;
+		}
+
+		pgm::job_pool job_pool(arguments.jobs);
+		job_pool.run(jobs, error, &internals->cancelled);
+		internals->cancelled = false;
+
+		// Keep the diagnostics of every unit that compiled, even when another one failed, because those units won't be compiled again.
+		// Jobs that never started have no duration.
+		for (std::vector<pgm::job_pool::job>::size_type j = 0; j < jobs.size(); j++) {
+			const unit &unit = units[job_units[j]];
+			if (jobs[j].duration == std::chrono::steady_clock::duration::zero()) {
+				continue;
+			}
+			std::vector<pgm::diagnostic> diagnostics = pgm::diagnostic::parse(jobs[j].stderr_output);
+			if (callbacks.diagnostic) {
+				for (const pgm::diagnostic &diagnostic : diagnostics) {
+					callbacks.diagnostic(unit, diagnostic);
+				}
+			}
+			if (jobs[j].exit_status != 0) {
+				continue;
+			}
+			pgm::diagnostic::save(unit.object, diagnostics, error);
+			internals->compile_times[unit.configuration][unit.source.string()] = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(jobs[j].duration).count());
+			// GCC prints its profile to stderr so keep it next to the object like clang does with its trace.
+			if (!arguments.profile.empty() && !internals->compilers[unit.configuration].is_clang()) {
+				pgm::profile::save_time_report(unit.object, jobs[j].stderr_output, error);
+			}
+		}
+		if (error) {
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append(std::format("Error compiling {} units.", units.size()));
+}
+
+void
+pgm::project::link(const callbacks &callbacks, error &error) {
+	do {
+		if (internals->units_by_configuration.empty()) {
+			find_units(error);
+			if (error) {
+				break;
+			}
+		}
+
+		for (std::vector<pgm::compiler>::size_type i = 0; i < internals->compilers.size(); i++) {
+			if (check_cancelled(error)) {
+				break;
+			}
+			const pgm::arguments::configuration &configuration = arguments.configurations[i];
+			// A shard records what it compiled for merge instead of linking. Its manifest is left alone so every shard keeps splitting the units the same way.
+			if (arguments.shard_count > 0) {
+				pgm::shard::record(configuration.object_directory, arguments.shard_index, arguments.shard_count, internals->units_by_configuration[i], internals->compilers[i], arguments.source_directory, error);
+				if (error) {
+					break;
+				}
+				internals->compile_times[i].clear();
+				continue;
+			}
+			if (internals->units_by_configuration[i].size() > 0) {
+				link_configuration(i, internals->units_by_configuration[i], callbacks, error);
+				if (error) {
+					break;
+				}
+			}
+
+			// Record the build so the next run can take the fast path.
+			// BMIs are recorded too because a deleted BMI must make the next run compile its interface again.
+			std::vector<std::filesystem::path> outputs;
+			if (arguments.modules) {
+				outputs = internals->modules.bmi_paths(configuration.object_directory);
+			}
+			pgm::manifest::writer writer(internals->compilers[i].fingerprint(configuration.out_file));
+			if (pgm::manifest::record(writer, internals->manifests[i], arguments.source_directory, internals->units_by_configuration[i], internals->compilers[i], configuration.out_file, internals->compile_times[i], *internals->scanner, outputs, error)) {
+				writer.save(pgm::manifest::path(configuration.object_directory), error);
+			}
+			if (error) {
+				break;
+			}
+			internals->compile_times[i].clear();
+		}
+		if (error) {
+			break;
+		}
+
+		// The scanner points into the old manifests. It's made again by the next call to outdated.
+		internals->scanner.reset();
+		internals->units_by_configuration.clear();
+		for (std::vector<pgm::arguments::configuration>::size_type i = 0; i < arguments.configurations.size(); i++) {
+			internals->manifests[i] = pgm::manifest::load(pgm::manifest::path(arguments.configurations[i].object_directory));
+		}
+		return;
+	} while (false);
+
+	error.append("Error linking.");
+}
+
+void
+pgm::project::merge(const callbacks &callbacks, error &error) {
+	do {
+		if (check_cancelled(error)) {
+			break;
+		}
+		const pgm::arguments::configuration &configuration = arguments.configurations[0];
+		std::vector<pgm::translation_unit> units = pgm::translation_unit::find_all(arguments.source_directory, configuration.object_directory, error, internals->generators.outputs());
+		if (error) {
+			break;
+		}
+		units = pgm::shard::merge(arguments.merge, units, internals->compilers[0], arguments.source_directory, error);
+		if (error) {
+			break;
+		}
+		if (units.empty()) {
+			return;
+		}
+		link_configuration(0, units, callbacks, error);
+		if (error) {
+			break;
+		}
+		return;
+	} while (false);
+
+	error.append("Error merging shards.");
+}
+
+void
+pgm::project::build(const callbacks &callbacks, error &error) {
+	std::vector<unit> units = outdated(error);
+	if (error) {
+		return;
+	}
+	compile(units, callbacks, error);
+	if (error) {
+		return;
+	}
+	link(callbacks, error);
+}
+
+void
+pgm::project::cancel() {
+	internals->cancelled = true;
+}
+
+void
+pgm::project::link_configuration(std::size_t configuration, const std::vector<pgm::translation_unit> &units, const callbacks &callbacks, error &error) {
+	if (arguments.lto && !internals->lto_cache_detected[configuration]) {
+		internals->compilers[configuration].detect_lto_cache(error);
+		if (error) {
+			return;
+		}
+		internals->lto_cache_detected[configuration] = true;
+	}
+	pgm::compiler::lto_report report;
+	std::chrono::steady_clock::time_point link_start = std::chrono::steady_clock::now();
+	internals->compilers[configuration].link(units, arguments.configurations[configuration].out_file, error, &report);
+	if (error) {
+		return;
+	}
+	if (callbacks.linked) {
+		callbacks.linked(configuration, std::chrono::steady_clock::now() - link_start);
+	}
+	if (callbacks.optimized && report.processes > 0) {
+		callbacks.optimized(configuration, report.time, report.processes);
+	}
+}
+
+bool
+pgm::project::check_cancelled(error &error) {
+	if (!internals->cancelled.exchange(false)) {
+		return false;
+	}
+	error.append("Cancelled.");
+	return true;
+}
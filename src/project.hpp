@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+
+#include "error.hpp"
+#include "arguments.hpp"
+#include "diagnostic.hpp"
+#include "translation_unit.hpp"
+
+namespace pgm {
+	class compiler;
+	class manifest;
+
+
+	// A source directory built with one set of arguments. The library interface of cromple ("libcromple") for tools that build in process, e.g. an IDE asking if a file is up to date or a test runner building only what it needs.
+	// The cromple executable is a client of this too. It adds printing: "--explain", "--graph" and "--profile".
+	//
+	// A project lives as long as the tool wants. The compilers (including what they support) and the manifests of the last build are kept between calls, everything that can change on disk (sources, headers, objects) is looked at again by every call.
+	// Calls are not thread safe except cancel, which is meant to be called from another thread while build, compile or link runs.
+	// Errors use pgm::error like the rest of cromple. Their messages are for people; only the fact that an error occurred is part of the interface.
+	// There is no stable ABI. The classes this exposes (arguments, manifest, compiler, ...) change with cromple so tools must be rebuilt against the headers of the libcromple they link.
+	// What the project keeps between calls is defined in project.cpp so changing it doesn't recompile tools.
+	class project {
+		public:
+		// A unit that has to be compiled.
+		class unit {
+			public:
+			// Index into arguments.configurations.
+			std::size_t configuration = 0;
+			std::filesystem::path source;
+			std::filesystem::path object;
+			// Why the unit has to be compiled.
+			pgm::translation_unit::trigger trigger;
+		};
+
+		// Called on the thread running build, compile or link. Any of them can be empty.
+		class callbacks {
+			public:
+			// A compile of unit started.
+			std::function<void (const unit &unit)> started;
+			// A compile of unit finished. succeeded is false if it failed or was cancelled.
+			std::function<void (const unit &unit, bool succeeded, std::chrono::steady_clock::duration duration)> finished;
+			// The compile of unit reported diagnostic. Called after finished, for failed compiles too.
+			std::function<void (const unit &unit, const pgm::diagnostic &diagnostic)> diagnostic;
+			// A configuration was linked.
+			std::function<void (std::size_t configuration, std::chrono::steady_clock::duration duration)> linked;
+			// With "--lto", the link of a configuration spent optimized on link time optimization, summed over the processes that did it. Called after linked. Only GCC reports this.
+			std::function<void (std::size_t configuration, std::chrono::steady_clock::duration optimized, std::size_t processes)> optimized;
+		};
+
+		const pgm::arguments arguments;
+
+		// Checks the source and object directories and loads the manifests of the last build. Object directories of named configurations are created.
+		project(const pgm::arguments &arguments, error &error);
+		~project();
+		project(const project &) = delete;
+		project &
+		operator=(const project &) = delete;
+
+		// Manifests of the last successful build of each configuration, indexed like arguments.configurations. Reloaded by link. Include "manifest.hpp" to use them.
+		const std::vector<pgm::manifest> &
+		recorded() const;
+
+		// Compiler of configuration, an index into arguments.configurations. Include "compiler.hpp" to use it.
+		const pgm::compiler &
+		compiler(std::size_t configuration) const;
+
+		// True if no file recorded by the last build changed, no compiler options changed and no generator has to run. Always false for a shard. Only stat calls, nothing is spawned and the source directory is not walked.
+		bool
+		up_to_date() const;
+
+		// Units of all configurations that have to be compiled, with why.
+		// Runs the generators whose inputs changed first, then walks the source directory and, with "--modules", scans for modules. Importers of module interfaces that have to be compiled are included.
+		std::vector<unit>
+		outdated(error &error);
+
+		// Compiles units, which should come from the last call to outdated. Units that import modules wait for the interfaces among units they import.
+		// Diagnostics of every compile that succeeded are stored next to its object, even when another compile failed.
+		void
+		compile(const std::vector<unit> &units, const callbacks &callbacks, error &error);
+
+		// Links every configuration and records the build in its manifest.
+		// With "--shard" nothing is linked. The units compiled are recorded for merge instead.
+		// Linking only makes sense once everything outdated returned was compiled. A manifest is not saved while an object is older than one of its headers so the next call to outdated still finds units that weren't compiled.
+		void
+		link(const callbacks &callbacks, error &error);
+
+		// Links the objects compiled by the shards in arguments.merge into the output of the only configuration. Every unit in the source directory must have been compiled by a shard with the compiler options given now.
+		// Nothing is recorded in a manifest.
+		void
+		merge(const callbacks &callbacks, error &error);
+
+		// outdated, compile and link.
+		void
+		build(const callbacks &callbacks, error &error);
+
+		// Stops build, compile or link as soon as possible. Running compiles are sent SIGTERM and the call returns with an error.
+		// Safe to call from any thread. Cancels the next call if nothing is running.
+		void
+		cancel();
+
+		private:
+		// Compilers, manifests and the rest of what is kept between calls.
+		class implementation;
+		std::unique_ptr<implementation> internals;
+
+		// Finds the units of all configurations and prepares a scanner for them.
+		void
+		find_units(error &error);
+
+		// Links units of configuration to out_file and calls the linked and optimized callbacks.
+		void
+		link_configuration(std::size_t configuration, const std::vector<pgm::translation_unit> &units, const callbacks &callbacks, error &error);
+
+		// Returns the error "Cancelled." and clears cancelled if cancel was called.
+		bool
+		check_cancelled(error &error);
+	};
+}
@@ -0,0 +1,527 @@
+#include "remote.hpp"
+
+#include <limits>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <format>
+#include <algorithm>
+
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "process.hpp"
+
+void
+pgm::remote::run(void *data) {
+	const remote::job &job = *static_cast<const remote::job *>(data);
+	pgm::error error;
+
+	do {
+		// Preprocess locally so workers don't need our headers or include paths.
+		// Output goes to a file so only stderr is piped, which can't deadlock.
+		process::child preprocessor = process::exec(job.preprocess_command, error);
+		if (error) {
+			break;
+		}
+		std::string preprocess_diagnostics = preprocessor.read_all_stderr_string(error);
+		int exit_status = preprocessor.wait(error);
+		if (error) {
+			break;
+		}
+		std::cerr << preprocess_diagnostics << std::flush;
+		if (exit_status != 0) {
+			std::filesystem::remove(job.preprocessed_path);
+			std::exit(exit_status);
+		}
+
+		remote::request request = job.request;
+		request.source = read_file(job.preprocessed_path, error);
+		std::filesystem::remove(job.preprocessed_path);
+		if (error) {
+			break;
+		}
+
+		for (const std::string &worker : job.workers) {
+			pgm::error worker_error;
+			remote::response response;
+			do {
+				int socket = connect(worker, job.timeout, worker_error);
+				if (worker_error) {
+					break;
+				}
+				write_request(socket, request, job.timeout, worker_error);
+				if (!worker_error) {
+					response = read_response(socket, job.timeout, worker_error);
+				}
+				::close(socket);
+				if (!worker_error && response.worker_error) {
+					worker_error.append(response.diagnostics);
+				}
+			} while (false);
+
+			// Unreachable, stalled or misbehaving workers are skipped. Only compiler failures are reported as failures.
+			if (worker_error) {
+				worker_error.append(std::format("Worker \"{}\" failed to compile \"{}\". Trying the next worker or compiling locally.", worker, job.object_path.string())).print();
+				continue;
+			}
+
+			std::cerr << response.diagnostics << std::flush;
+			if (response.exit_status == 0) {
+				write_file_atomically(job.object_path, response.object, error);
+				if (error) {
+					break;
+				}
+			}
+			std::exit(response.exit_status);
+		}
+		if (error) {
+			break;
+		}
+
+		// No worker could compile the unit so compile it here.
+		process::child compiler = process::exec(job.local_command, error);
+		if (error) {
+			break;
+		}
+		std::string diagnostics = compiler.read_all_stderr_string(error);
+		exit_status = compiler.wait(error);
+		if (error) {
+			break;
+		}
+		std::cerr << diagnostics << std::flush;
+		std::exit(exit_status);
+	} while (false);
+
+	std::exit(error.append(std::format("Error compiling \"{}\" remotely.", job.object_path.string())).print());
+}
+
+std::string
+pgm::remote::preprocessed_language(const std::vector<std::string> &command_parts, const std::filesystem::path &source) {
+	// An explicit "-x" wins.
+	for (std::vector<std::string>::size_type i = 1; i + 1 < command_parts.size(); i++) {
+		if (command_parts[i] == "-x") {
+			const std::string &language = command_parts[i + 1];
+			return language == "c" ? "cpp-output" : "c++-cpp-output";
+		}
+	}
+	// C++ drivers like g++ and clang++ compile ".c" files as C++.
+	if (std::filesystem::path(command_parts[0]).filename().string().find("++") != std::string::npos) {
+		return "c++-cpp-output";
+	}
+	return source.extension() == ".c" ? "cpp-output" : "c++-cpp-output";
+}
+
+std::vector<std::string>
+pgm::remote::request_arguments(const std::vector<std::string> &compiler_arguments) {
+	// Options taking a value that is given as the next argument when it isn't joined, like "-I dir" and "-Idir".
+	static const std::vector<std::string> preprocessor_options {"-I", "-iquote", "-isystem", "-idirafter", "-include", "-imacros", "-D", "-U", "-MF", "-MT", "-MQ", "-x"};
+	// Options without a value.
+	static const std::vector<std::string> preprocessor_flags {"-M", "-MM", "-MD", "-MMD", "-MG", "-MP", "-nostdinc", "-nostdinc++"};
+
+	std::vector<std::string> arguments;
+	for (std::vector<std::string>::size_type i = 0; i < compiler_arguments.size(); i++) {
+		const std::string &argument = compiler_arguments[i];
+		if (std::find(preprocessor_flags.begin(), preprocessor_flags.end(), argument) != preprocessor_flags.end()) {
+			continue;
+		}
+		std::vector<std::string>::const_iterator option = std::find_if(preprocessor_options.begin(), preprocessor_options.end(), [&argument](const std::string &option) {
+			return argument.starts_with(option);
+		});
+		if (option != preprocessor_options.end()) {
+			// Skip the value too when it's separate.
+			if (argument == *option) {
+				i++;
+			}
+			continue;
+		}
+		arguments.push_back(argument);
+	}
+	return arguments;
+}
+
+std::string
+pgm::remote::rejected_argument(const std::vector<std::string> &arguments) {
+	// Allowed prefixes that still match options which load code, touch files or pass options on to other programs.
+	static const std::vector<std::string> refused_prefixes {
+		"-fplugin", "-fdump-", "-fopt-info", "-fprofile-", "-fauto-profile", "-fcallgraph-info", "-fsave-optimization-record",
+		"-fmodule-mapper", "-fmodules", "-fdiagnostics-add-output", "-fdiagnostics-format=sarif-file", "-fcrash-diagnostics", "-ftime-trace",
+		"-fsanitize-blacklist", "-fsanitize-ignorelist", "-fsanitize-coverage-allowlist", "-fsanitize-coverage-ignorelist", "-fxray-attr-list", "-fxray-always-instrument", "-fxray-never-instrument",
+		"-Wa,", "-Wl,", "-Wp,", "-mllvm",
+	};
+	static const std::vector<std::string> allowed_prefixes {"-O", "-f", "-W", "-m", "-g", "-std=", "-D", "-U", "-pedantic"};
+
+	for (std::vector<std::string>::size_type i = 0; i < arguments.size(); i++) {
+		const std::string &argument = arguments[i];
+		if (argument == "-w") {
+			continue;
+		}
+		// A separate macro is just a name and a value for the compiler.
+		if ((argument == "-D" || argument == "-U") && i + 1 < arguments.size()) {
+			i++;
+			continue;
+		}
+		bool refused = std::any_of(refused_prefixes.begin(), refused_prefixes.end(), [&argument](const std::string &prefix) {
+			return argument.starts_with(prefix);
+		});
+		bool allowed = std::any_of(allowed_prefixes.begin(), allowed_prefixes.end(), [&argument](const std::string &prefix) {
+			return argument.starts_with(prefix);
+		});
+		if (refused || !allowed) {
+			return argument;
+		}
+	}
+	return "";
+}
+
+int
+pgm::remote::connect(const std::string &address, std::chrono::milliseconds timeout, error &error) {
+	do {
+		std::string::size_type colon = address.rfind(':');
+		if (colon == std::string::npos) {
+			error.append("Address must look like \"host:port\".");
+			break;
+		}
+		std::string host = address.substr(0, colon);
+		std::string port = address.substr(colon + 1);
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo *addresses;
+		int status = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+		if (status != 0) {
+			error.append(::gai_strerror(status));
+			break;
+		}
+
+		// Each address gets the whole timeout. Usually there is only one.
+		// Failures are collected apart from error because only the last address failing is an error.
+		int socket = -1;
+		pgm::error connect_error;
+		for (addrinfo *info = addresses; info != nullptr; info = info->ai_next) {
+			// Non-blocking so connecting to a host that drops packets can be given up on.
+			socket = ::socket(info->ai_family, info->ai_socktype | SOCK_NONBLOCK, info->ai_protocol);
+			if (socket == -1) {
+				connect_error.strerror();
+				continue;
+			}
+			if (::connect(socket, info->ai_addr, info->ai_addrlen) == 0) {
+				break;
+			}
+			if (errno == EINPROGRESS) {
+				pgm::error wait_error;
+				wait(socket, POLLOUT, std::chrono::steady_clock::now() + timeout, wait_error);
+				int socket_error = 0;
+				socklen_t socket_error_size = sizeof(socket_error);
+				if (wait_error) {
+					connect_error.append(std::format("Timed out after {} ms.", timeout.count()));
+				} else if (::getsockopt(socket, SOL_SOCKET, SO_ERROR, &socket_error, &socket_error_size) == 0 && socket_error == 0) {
+					break;
+				} else {
+					errno = socket_error;
+					connect_error.strerror();
+				}
+			} else {
+				connect_error.strerror();
+			}
+			::close(socket);
+			socket = -1;
+		}
+		::freeaddrinfo(addresses);
+		if (socket == -1) {
+			error = connect_error;
+			break;
+		}
+		return socket;
+	} while (false);
+
+	error.append(std::format("Error connecting to worker \"{}\".", address));
+	return -1;
+}
+
+int
+pgm::remote::listen(const std::string &address, std::uint16_t &port, error &error) {
+	do {
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		addrinfo *addresses;
+		std::string port_string = std::to_string(port);
+		int status = ::getaddrinfo(address.c_str(), port_string.c_str(), &hints, &addresses);
+		if (status != 0) {
+			error.append(::gai_strerror(status));
+			break;
+		}
+
+		int socket = -1;
+		for (addrinfo *info = addresses; info != nullptr; info = info->ai_next) {
+			socket = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+			if (socket == -1) {
+				continue;
+			}
+			int reuse = 1;
+			::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			if (::bind(socket, info->ai_addr, info->ai_addrlen) == 0 && ::listen(socket, SOMAXCONN) == 0) {
+				break;
+			}
+			::close(socket);
+			socket = -1;
+		}
+		::freeaddrinfo(addresses);
+		if (socket == -1) {
+			error.strerror();
+			break;
+		}
+
+		// Find out which port was picked when port was 0.
+		sockaddr_storage bound{};
+		socklen_t bound_size = sizeof(bound);
+		if (::getsockname(socket, reinterpret_cast<sockaddr *>(&bound), &bound_size) == -1) {
+			error.strerror();
+			::close(socket);
+			break;
+		}
+		port = ntohs(bound.ss_family == AF_INET6
+			? reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port
+			: reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+		return socket;
+	} while (false);
+
+	error.append(std::format("Error listening on \"{}\" port {}.", address, port));
+	return -1;
+}
+
+void
+pgm::remote::write_request(int socket, const request &request, std::chrono::milliseconds timeout, error &error) {
+	write_frame(socket, protocol, timeout, error);
+	write_frame(socket, request.language, timeout, error);
+	write_frame(socket, std::to_string(request.arguments.size()), timeout, error);
+	for (const std::string &argument : request.arguments) {
+		write_frame(socket, argument, timeout, error);
+	}
+	write_frame(socket, request.source, timeout, error);
+	if (error) {
+		error.append("Error writing compile request.");
+	}
+}
+
+pgm::remote::request
+pgm::remote::read_request(int socket, std::chrono::milliseconds timeout, error &error) {
+	remote::request request;
+	do {
+		std::string received_protocol = read_frame(socket, timeout, error);
+		if (error) {
+			break;
+		}
+		if (received_protocol != protocol) {
+			error.append(std::format("Expected protocol \"{}\" but got \"{}\".", protocol, received_protocol));
+			break;
+		}
+		request.language = read_frame(socket, timeout, error);
+		int argument_count = read_number_frame(socket, timeout, error);
+		for (int i = 0; !error && i < argument_count; i++) {
+			request.arguments.push_back(read_frame(socket, timeout, error));
+		}
+		request.source = read_frame(socket, timeout, error);
+		if (error) {
+			break;
+		}
+		return request;
+	} while (false);
+
+	error.append("Error reading compile request.");
+	return request;
+}
+
+void
+pgm::remote::write_response(int socket, const response &response, std::chrono::milliseconds timeout, error &error) {
+	write_frame(socket, response.worker_error ? "worker error" : "compiled", timeout, error);
+	write_frame(socket, std::to_string(response.exit_status), timeout, error);
+	write_frame(socket, response.diagnostics, timeout, error);
+	write_frame(socket, response.object, timeout, error);
+	if (error) {
+		error.append("Error writing compile response.");
+	}
+}
+
+pgm::remote::response
+pgm::remote::read_response(int socket, std::chrono::milliseconds timeout, error &error) {
+	remote::response response;
+	std::string outcome = read_frame(socket, timeout, error);
+	if (!error && outcome != "compiled" && outcome != "worker error") {
+		error.append(std::format("Expected outcome \"compiled\" or \"worker error\" but got \"{}\". The worker may speak another protocol than \"{}\".", outcome, protocol));
+	}
+	response.worker_error = outcome == "worker error";
+	response.exit_status = read_number_frame(socket, timeout, error);
+	response.diagnostics = read_frame(socket, timeout, error);
+	response.object = read_frame(socket, timeout, error);
+	if (error) {
+		error.append("Error reading compile response.");
+	}
+	return response;
+}
+
+void
+pgm::remote::wait(int socket, short events, std::chrono::steady_clock::time_point deadline, error &error) {
+	while (true) {
+		std::chrono::milliseconds remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if (remaining <= std::chrono::milliseconds::zero()) {
+			error.append("Timed out.");
+			return;
+		}
+		pollfd poll_fd{socket, events, 0};
+		int ready = ::poll(&poll_fd, 1, static_cast<int>(std::min<std::chrono::milliseconds::rep>(remaining.count(), std::numeric_limits<int>::max())));
+		if (ready == -1 && errno == EINTR) {
+			continue;
+		}
+		if (ready == -1) {
+			error.strerror().append("Error polling socket.");
+			return;
+		}
+		// Errors and hang ups are reported by the send or recv that follows.
+		if (ready == 1) {
+			return;
+		}
+	}
+}
+
+void
+pgm::remote::write_frame(int socket, const std::string &frame, std::chrono::milliseconds timeout, error &error) {
+	if (error) {
+		return;
+	}
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+	unsigned char header[8];
+	std::uint64_t size = frame.size();
+	for (unsigned char &byte : header) {
+		byte = static_cast<unsigned char>(size & 0xff);
+		size >>= 8;
+	}
+
+	std::string message(reinterpret_cast<char *>(header), sizeof(header));
+	message += frame;
+
+	std::string::size_type written = 0;
+	while (written < message.size()) {
+		wait(socket, POLLOUT, deadline, error);
+		if (error) {
+			error.append("Error writing frame to socket.");
+			return;
+		}
+		// MSG_NOSIGNAL so a worker hanging up is an error instead of a SIGPIPE.
+		// MSG_DONTWAIT so a send bigger than the free buffer space returns early instead of blocking past the deadline.
+		ssize_t bytes_written = ::send(socket, message.data() + written, message.size() - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (bytes_written == -1) {
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+				continue;
+			}
+			error.strerror().append("Error writing frame to socket.");
+			return;
+		}
+		written += static_cast<std::string::size_type>(bytes_written);
+	}
+}
+
+std::string
+pgm::remote::read_frame(int socket, std::chrono::milliseconds timeout, error &error) {
+	if (error) {
+		return std::string();
+	}
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+	// Reads exactly size bytes into buffer before the deadline.
+	auto read_exactly = [socket, deadline, &error](char *buffer, std::size_t size) {
+		std::size_t received = 0;
+		while (received < size) {
+			wait(socket, POLLIN, deadline, error);
+			if (error) {
+				error.append("Error reading frame from socket.");
+				return;
+			}
+			ssize_t bytes_read = ::recv(socket, buffer + received, size - received, MSG_DONTWAIT);
+			if (bytes_read == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+				continue;
+			}
+			if (bytes_read == -1) {
+				error.strerror().append("Error reading frame from socket.");
+				return;
+			}
+			if (bytes_read == 0) {
+				error.append("Connection closed in the middle of a frame.");
+				return;
+			}
+			received += static_cast<std::size_t>(bytes_read);
+		}
+	};
+
+	unsigned char header[8];
+	read_exactly(reinterpret_cast<char *>(header), sizeof(header));
+	if (error) {
+		return std::string();
+	}
+	std::uint64_t size = 0;
+	for (int i = 7; i >= 0; i--) {
+		size = (size << 8) | header[i];
+	}
+
+	// Nothing sane is this big. Protects against allocating garbage sizes from something that isn't a cromple peer.
+	constexpr std::uint64_t maximum_size = std::uint64_t(1) << 32;
+	if (size > maximum_size) {
+		error.append(std::format("Frame size {} is larger than the maximum {}.", size, maximum_size));
+		return std::string();
+	}
+
+	std::string frame(size, '\0');
+	read_exactly(frame.data(), frame.size());
+	return frame;
+}
+
+int
+pgm::remote::read_number_frame(int socket, std::chrono::milliseconds timeout, error &error) {
+	std::string frame = read_frame(socket, timeout, error);
+	if (error) {
+		return 0;
+	}
+	try {
+		return std::stoi(frame);
+	} catch (const std::exception &exception) {
+		error.append(std::format("Expected a number frame but got \"{}\".", frame));
+		return 0;
+	}
+}
+
+std::string
+pgm::remote::read_file(const std::filesystem::path &path, error &error) {
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream content;
+	content << file.rdbuf();
+	if (!file) {
+		error.append(std::format("Error reading file \"{}\".", path.string()));
+		return std::string();
+	}
+	return content.str();
+}
+
+void
+pgm::remote::write_file_atomically(const std::filesystem::path &path, const std::string &content, error &error) {
+	std::filesystem::path temporary_path = path;
+	temporary_path += std::format(".{}.tmp", ::getpid());
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		file.write(content.data(), static_cast<std::streamsize>(content.size()));
+		if (!file) {
+			error.append(std::format("Error writing file \"{}\".", temporary_path.string()));
+			return;
+		}
+	}
+	std::error_code error_code;
+	std::filesystem::rename(temporary_path, path, error_code);
+	if (error_code) {
+		error.append(error_code.message()).append(std::format("Error renaming \"{}\" to \"{}\".", temporary_path.string(), path.string()));
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include "error.hpp"
+
+namespace pgm {
+	// Compiling preprocessed translation units on cromple-worker processes over TCP.
+	//
+	// The protocol is deliberately dumb so it's easy to debug with a hex dump.
+	// Every message is a sequence of frames. A frame is an 8 byte little endian length followed by that many bytes.
+	// Request frames: protocol, language, argument count, arguments..., preprocessed source.
+	// Response frames: outcome ("compiled", or "worker error" when the worker couldn't run its compiler), exit status, diagnostics (compiler stderr), object file (empty when compilation failed).
+	// Numbers are sent as decimal strings.
+	// One connection carries exactly one request and one response.
+	// Connecting and sending or receiving each frame must finish within a timeout so a worker that stalls is skipped instead of blocking the build.
+	class remote {
+		public:
+		// First frame of a request. Bump the version when changing the frames.
+		static constexpr const char *protocol = "cromple-remote 2";
+
+		// Default time allowed for connecting and for each frame. The first response frame is only sent when the compile is done so it must be longer than the slowest compile.
+		static constexpr std::chrono::seconds default_timeout{300};
+
+		class request {
+			public:
+			// Language of the preprocessed source as understood by "-x", e.g. "c++-cpp-output".
+			std::string language;
+			// Compiler arguments. Input, output and "-c" are added by the worker.
+			std::vector<std::string> arguments;
+			std::string source;
+		};
+
+		class response {
+			public:
+			// The worker failed, not the compile, e.g. it couldn't run its compiler. exit_status is meaningless and diagnostics say what went wrong.
+			bool worker_error = false;
+			int exit_status = 0;
+			std::string diagnostics;
+			std::string object;
+		};
+
+		// Everything a forked child needs to compile one unit remotely.
+		class job {
+			public:
+			// "host:port" of workers in the order they should be tried.
+			std::vector<std::string> workers;
+			// Command that preprocesses the source to preprocessed_path.
+			std::vector<std::string> preprocess_command;
+			std::filesystem::path preprocessed_path;
+			// Request without source. The source is read from preprocessed_path.
+			pgm::remote::request request;
+			std::filesystem::path object_path;
+			// Command used when no worker can be reached.
+			std::vector<std::string> local_command;
+			// Time allowed for connecting to a worker and for each frame. A worker that takes longer is skipped like an unreachable one.
+			std::chrono::milliseconds timeout = default_timeout;
+		};
+
+		// Runs in a child process started by process::fork with a pointer to a job.
+		// Preprocesses locally, compiles on the first worker that accepts a connection and answers in time without a worker error and writes the object.
+		// Falls back to running local_command in place of this process when no worker can compile the unit.
+		// Diagnostics are written to stderr and the process exits with the compilers exit status.
+		static void
+		run(void *job);
+
+		// Returns the "-x" language of the preprocessed output of source compiled with command_parts.
+		static std::string
+		preprocessed_language(const std::vector<std::string> &command_parts, const std::filesystem::path &source);
+
+		// compiler_arguments without the ones that only affect preprocessing, which is done before a request is sent: include directories, macros, forced includes, dependency files and "-x".
+		static std::vector<std::string>
+		request_arguments(const std::vector<std::string> &compiler_arguments);
+
+		// First argument a worker refuses to pass to its compiler. Empty if it accepts them all.
+		// Workers don't authenticate clients so only code generation and warning options are accepted: "-O*", "-f*", "-W*", "-m*", "-g*", "-std=", "-D", "-U", "-w" and "-pedantic*".
+		// Options that load plugins, read or write files other than the object or hand options to other programs are refused even then, e.g. "-fplugin=", "-fdump-*", "-fprofile-use=", "-Wl,", "-mllvm". "-o", "@file", "-wrapper" and "-specs=" are never in the list.
+		static std::string
+		rejected_argument(const std::vector<std::string> &arguments);
+
+		// Connects to a "host:port" address within timeout and returns the socket.
+		static int
+		connect(const std::string &address, std::chrono::milliseconds timeout, error &error);
+
+		// Listens on address and port. Port 0 picks a free port and stores it in port.
+		static int
+		listen(const std::string &address, std::uint16_t &port, error &error);
+
+		static void
+		write_request(int socket, const request &request, std::chrono::milliseconds timeout, error &error);
+
+		static request
+		read_request(int socket, std::chrono::milliseconds timeout, error &error);
+
+		static void
+		write_response(int socket, const response &response, std::chrono::milliseconds timeout, error &error);
+
+		static response
+		read_response(int socket, std::chrono::milliseconds timeout, error &error);
+
+		private:
+		// Waits until socket is ready for events (POLLIN or POLLOUT) or deadline passes, which is an error.
+		static void
+		wait(int socket, short events, std::chrono::steady_clock::time_point deadline, error &error);
+
+		// Sends the whole frame within timeout.
+		static void
+		write_frame(int socket, const std::string &frame, std::chrono::milliseconds timeout, error &error);
+
+		// Receives a whole frame within timeout.
+		static std::string
+		read_frame(int socket, std::chrono::milliseconds timeout, error &error);
+
+		static int
+		read_number_frame(int socket, std::chrono::milliseconds timeout, error &error);
+
+		static std::string
+		read_file(const std::filesystem::path &path, error &error);
+
+		// Writes to a temporary file and renames it over path so a half written object is never left behind.
+		static void
+		write_file_atomically(const std::filesystem::path &path, const std::string &content, error &error);
+	};
+}
@@ -0,0 +1,118 @@
+#include "scanner.hpp"
+
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "manifest.hpp"
+
+pgm::scanner::scanner(const pgm::compiler &compiler, const std::string &mode, const std::vector<std::string> &compiler_arguments) : compiler{compiler}, mode{mode}, include_scanner{compiler_arguments} {}
+
+void
+pgm::scanner::add_manifest(const pgm::manifest &manifest) {
+	manifests.push_back(&manifest);
+}
+
+const std::vector<std::string> &
+pgm::scanner::prerequisites(const pgm::translation_unit &unit, error &error) {
+	std::map<std::filesystem::path, std::vector<std::string>>::iterator iterator = prerequisites_by_source.find(unit.root_path);
+	if (iterator != prerequisites_by_source.end()) {
+		return iterator->second;
+	}
+
+	std::vector<std::string> prerequisites;
+
+	// A manifest that recorded this exact object knows what it was built from without reading or parsing anything.
+	for (const pgm::manifest *manifest : manifests) {
+		std::uint32_t recorded = manifest->find(unit.root_path);
+		if (recorded == pgm::manifest::no_unit) {
+			continue;
+		}
+		std::uint32_t object = manifest->unit_object(recorded);
+		if (manifest->path_of(object) != unit.object_path.string() || manifest->file_of(object) != pgm::manifest::stat(unit.object_path)) {
+			continue;
+		}
+		for (std::uint32_t prerequisite : manifest->prerequisites(recorded)) {
+			prerequisites.emplace_back(manifest->path_of(prerequisite));
+		}
+		return prerequisites_by_source.emplace(unit.root_path, std::move(prerequisites)).first->second;
+	}
+
+	// The dependency file lists what the object was built from. If none of those changed then the list itself is still correct.
+	if (!read_dependency_file(unit.dependency_path, prerequisites)) {
+		prerequisites = scan(unit.root_path, error);
+		if (error) {
+			error.append(std::format("Error scanning prerequisites of \"{}\".", unit.root_path.string()));
+			static const std::vector<std::string> empty;
+			return empty;
+		}
+	}
+	return prerequisites_by_source.emplace(unit.root_path, std::move(prerequisites)).first->second;
+}
+
+bool
+pgm::scanner::read_dependency_file(const std::filesystem::path &path, std::vector<std::string> &prerequisites) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::stringstream rule;
+	rule << file.rdbuf();
+	prerequisites = pgm::compiler::parse_make_prerequisites(rule.str());
+	// A dependency file always lists at least the source itself. An empty one was cut short.
+	return !prerequisites.empty();
+}
+
+std::vector<std::string>
+pgm::scanner::scan(const std::filesystem::path &source, error &error) {
+	if (mode != "compiler" && !system_directories_added) {
+		include_scanner.add_system_directories(compiler.system_include_directories(error));
+		if (error) {
+			return {};
+		}
+		system_directories_added = true;
+	}
+
+	std::vector<std::string> native;
+	std::string reason;
+	bool certain = mode != "compiler" && include_scanner.prerequisites(source, native, reason);
+	if (certain && mode == "native") {
+		return native;
+	}
+
+	std::vector<std::string> prerequisites = compiler.get_make_prerequisites(source.string(), error);
+	if (error || mode != "verify") {
+		return prerequisites;
+	}
+
+	if (!certain) {
+		std::cerr << std::format("Native scanner is unsure about \"{}\" and would use the compiler: {}", source.string(), reason) << std::endl;
+		return prerequisites;
+	}
+
+	// Compare normalised paths because the compiler and the native scanner may spell the same path differently, e.g. "dir/../header.hpp".
+	auto normalise = [](const std::vector<std::string> &paths) {
+		std::vector<std::string> normalised;
+		for (const std::string &path : paths) {
+			normalised.push_back(std::filesystem::path(path).lexically_normal().string());
+		}
+		std::sort(normalised.begin(), normalised.end());
+		normalised.erase(std::unique(normalised.begin(), normalised.end()), normalised.end());
+		return normalised;
+	};
+	std::vector<std::string> expected = normalise(prerequisites);
+	std::vector<std::string> found = normalise(native);
+	std::vector<std::string> missing;
+	std::vector<std::string> extra;
+	std::set_difference(expected.begin(), expected.end(), found.begin(), found.end(), std::back_inserter(missing));
+	std::set_difference(found.begin(), found.end(), expected.begin(), expected.end(), std::back_inserter(extra));
+	for (const std::string &path : missing) {
+		std::cerr << std::format("Native scanner missed \"{}\" in prerequisites of \"{}\".", path, source.string()) << std::endl;
+	}
+	for (const std::string &path : extra) {
+		std::cerr << std::format("Native scanner found \"{}\" in prerequisites of \"{}\" but the compiler did not.", path, source.string()) << std::endl;
+	}
+	return prerequisites;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <filesystem>
+
+#include "error.hpp"
+#include "compiler.hpp"
+#include "translation_unit.hpp"
+#include "include_scanner.hpp"
+
+namespace pgm {
+	class compiler;
+	class translation_unit;
+	class manifest;
+
+	// Finds and remembers the prerequisites (source and #included headers) of source files.
+	// Every source is scanned at most once per invocation no matter how many configurations check it.
+	class scanner {
+		// Compiler used to generate make rules with -MM.
+		const pgm::compiler &compiler;
+		std::map<std::filesystem::path, std::vector<std::string>> prerequisites_by_source;
+		// Manifests of previous builds. Prerequisites recorded for an object that hasn't changed since are used without reading anything.
+		std::vector<const pgm::manifest *> manifests;
+		// "compiler", "native" or "verify". See pgm::arguments::scanner.
+		std::string mode;
+		pgm::include_scanner include_scanner;
+		// The compilers system include directories are only listed for the first native scan so "--scanner compiler" never runs the compiler for them.
+		bool system_directories_added = false;
+
+		// Scans with include_scanner and/or the compiler depending on mode.
+		std::vector<std::string>
+		scan(const std::filesystem::path &source, error &error);
+
+		public:
+		// compiler_arguments are the arguments compiler was created with. The native scanner takes include directories from them.
+		scanner(const pgm::compiler &compiler, const std::string &mode, const std::vector<std::string> &compiler_arguments);
+
+		// Uses the prerequisites recorded in manifest when it's asked about a unit whose object hasn't changed since manifest was recorded.
+		// manifest must outlive the scanner.
+		void
+		add_manifest(const pgm::manifest &manifest);
+
+		// Returns the prerequisites of unit.root_path, scanning it if it has not been scanned yet.
+		// A manifest or the dependency file written by the last compile of unit are used when possible so no compiler has to run.
+		const std::vector<std::string> &
+		prerequisites(const pgm::translation_unit &unit, error &error);
+
+		// Reads the prerequisites from a dependency file written during compile.
+		// Returns false if the file does not exist or can't be read.
+		static bool
+		read_dependency_file(const std::filesystem::path &path, std::vector<std::string> &prerequisites);
+	};
+}
@@ -0,0 +1,233 @@
+#include "shard.hpp"
+
+#include <map>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <charconv>
+#include <algorithm>
+
+// First line of a shard record. Changed when the format changes.
+static constexpr std::string_view record_magic = "cromple-shard 3";
+
+std::vector<pgm::translation_unit>
+pgm::shard::select(const std::vector<pgm::translation_unit> &units, const pgm::manifest &costs, unsigned index, unsigned count) {
+	// Compile times by file name.
+	std::map<std::string, std::uint64_t> compile_times;
+	for (std::uint32_t unit = 0; unit < costs.unit_count(); unit++) {
+		compile_times[std::filesystem::path(costs.path_of(costs.unit_source(unit))).filename().string()] = costs.unit_compile_time(unit);
+	}
+
+	std::vector<std::string> names;
+	std::vector<std::uint64_t> unit_costs;
+	std::uint64_t known_cost = 0;
+	std::size_t known = 0;
+	for (const pgm::translation_unit &unit : units) {
+		names.push_back(unit.root_path.filename().string());
+		std::map<std::string, std::uint64_t>::const_iterator recorded = compile_times.find(names.back());
+		unit_costs.push_back(recorded == compile_times.end() ? 0 : recorded->second);
+		known_cost += unit_costs.back();
+		known += unit_costs.back() != 0;
+	}
+
+	std::vector<pgm::translation_unit> selected;
+	if (known == 0) {
+		for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+			// Never change how a name is hashed or shards built by different versions would disagree.
+			if (pgm::compiler::hash({names[i]}) % count == index) {
+				selected.push_back(units[i]);
+			}
+		}
+		return selected;
+	}
+
+	std::uint64_t average = known_cost / known;
+	for (std::uint64_t &cost : unit_costs) {
+		if (cost == 0) {
+			cost = average;
+		}
+	}
+	// Longest processing time first. Ties are broken by name so every shard sorts the same way whatever order the directory was listed in.
+	std::vector<std::vector<pgm::translation_unit>::size_type> order(units.size());
+	for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&unit_costs, &names](std::vector<pgm::translation_unit>::size_type a, std::vector<pgm::translation_unit>::size_type b) {
+		if (unit_costs[a] != unit_costs[b]) {
+			return unit_costs[a] > unit_costs[b];
+		}
+		return names[a] < names[b];
+	});
+	std::vector<std::uint64_t> loads(count, 0);
+	for (std::vector<pgm::translation_unit>::size_type i : order) {
+		// The first of the least loaded shards.
+		std::vector<std::uint64_t>::size_type target = static_cast<std::vector<std::uint64_t>::size_type>(std::min_element(loads.begin(), loads.end()) - loads.begin());
+		loads[target] += unit_costs[i];
+		if (target == index) {
+			selected.push_back(units[i]);
+		}
+	}
+	return selected;
+}
+
+std::uint64_t
+pgm::shard::fingerprint(const pgm::compiler &compiler, const pgm::translation_unit &unit, const std::filesystem::path &source_directory) {
+	// The compile command with the source and object relative to their directories.
+	std::vector<std::string> command = compiler.compile_command(pgm::translation_unit(unit.root_path.filename(), ""));
+
+	// Roots of the checkout, most specific first, with the placeholder that replaces them. A root only matches whole path components so "/src" doesn't match "/srcs".
+	std::error_code error_code;
+	std::string working_directory = std::filesystem::current_path(error_code).string();
+	std::vector<std::pair<std::string, std::string>> roots {
+		{std::filesystem::absolute(source_directory, error_code).lexically_normal().string(), "<source>"},
+		{working_directory, "<working>"},
+	};
+	for (std::pair<std::string, std::string> &root : roots) {
+		while (root.first.size() > 1 && root.first.ends_with('/')) {
+			root.first.pop_back();
+		}
+	}
+	for (std::string &part : command) {
+		for (const std::pair<std::string, std::string> &root : roots) {
+			// "/" would match every absolute path.
+			if (root.first.size() <= 1) {
+				continue;
+			}
+			for (std::string::size_type found = part.find(root.first); found != std::string::npos; found = part.find(root.first, found)) {
+				std::string::size_type end = found + root.first.size();
+				if (end != part.size() && part[end] != '/') {
+					found = end;
+					continue;
+				}
+				part.replace(found, root.first.size(), root.second);
+				found += root.second.size();
+			}
+		}
+	}
+	return pgm::compiler::hash(command);
+}
+
+std::filesystem::path
+pgm::shard::record_path(const std::filesystem::path &object_directory) {
+	return object_directory / "cromple.shard";
+}
+
+void
+pgm::shard::record(const std::filesystem::path &object_directory, unsigned index, unsigned count, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &source_directory, error &error) {
+	// Text because it's small and people debugging a CI split will want to read it:
+	// cromple-shard 3
+	// shard K N
+	// unit FINGERPRINT FILE_NAME
+	std::filesystem::path path = record_path(object_directory);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << record_magic << "\n";
+	file << std::format("shard {} {}\n", index + 1, count);
+	for (const pgm::translation_unit &unit : units) {
+		file << std::format("unit {:016x} {}\n", fingerprint(compiler, unit, source_directory), unit.root_path.filename().string());
+	}
+	file.close();
+	if (!file) {
+		error.append(std::format("Error writing shard record \"{}\".", path.string()));
+	}
+}
+
+std::vector<pgm::translation_unit>
+pgm::shard::merge(const std::vector<std::filesystem::path> &shard_directories, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &source_directory, error &error) {
+	// Shard directory and fingerprint of each unit, by file name.
+	class compiled {
+		public:
+		std::filesystem::path directory;
+		std::uint64_t fingerprint;
+	};
+	std::map<std::string, compiled> compiled_units;
+	unsigned count = 0;
+	std::vector<bool> seen;
+
+	for (const std::filesystem::path &directory : shard_directories) {
+		std::filesystem::path path = record_path(directory);
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			error.append(std::format("Shard record \"{}\" is missing. Build the shard with \"--shard K/N\" and \"--objects {}\" first.", path.string(), directory.string()));
+			continue;
+		}
+		std::string line;
+		unsigned index = 0;
+		unsigned shard_count = 0;
+		// "shard K N". std::from_chars rejects signs and numbers that don't fit.
+		auto read_shard = [&line, &index, &shard_count]() {
+			std::string_view rest = line;
+			if (!rest.starts_with("shard ")) {
+				return false;
+			}
+			rest.remove_prefix(6);
+			std::from_chars_result result = std::from_chars(rest.data(), rest.data() + rest.size(), index);
+			if (result.ec != std::errc() || result.ptr == rest.data() + rest.size() || *result.ptr != ' ') {
+				return false;
+			}
+			rest.remove_prefix(static_cast<std::string_view::size_type>(result.ptr + 1 - rest.data()));
+			result = std::from_chars(rest.data(), rest.data() + rest.size(), shard_count);
+			return result.ec == std::errc() && result.ptr == rest.data() + rest.size();
+		};
+		if (!std::getline(file, line) || line != record_magic || !std::getline(file, line) || !read_shard() || index == 0 || index > shard_count) {
+			error.append(std::format("Shard record \"{}\" is damaged or from another version of cromple.", path.string()));
+			continue;
+		}
+		if (count == 0) {
+			count = shard_count;
+			seen.assign(count, false);
+		}
+		if (shard_count != count) {
+			error.append(std::format("Shard record \"{}\" is part of a split into {} shards but the first shard is part of a split into {}.", path.string(), shard_count, count));
+			continue;
+		}
+		if (seen[index - 1]) {
+			error.append(std::format("Shard {}/{} is given twice, the second time in \"{}\".", index, count, directory.string()));
+			continue;
+		}
+		seen[index - 1] = true;
+
+		while (std::getline(file, line)) {
+			std::istringstream stream(line);
+			std::string keyword;
+			compiled unit{directory, 0};
+			stream >> keyword >> std::hex >> unit.fingerprint;
+			std::string name;
+			// The name is the rest of the line and can contain spaces.
+			if (keyword != "unit" || !stream || !std::getline(stream >> std::ws, name)) {
+				error.append(std::format("Shard record \"{}\" has an invalid line \"{}\".", path.string(), line));
+				break;
+			}
+			compiled_units.emplace(name, unit);
+		}
+	}
+	for (unsigned i = 0; i < count; i++) {
+		if (!seen[i]) {
+			error.append(std::format("Shard {}/{} is missing.", i + 1, count));
+		}
+	}
+
+	std::vector<pgm::translation_unit> merged;
+	for (const pgm::translation_unit &unit : units) {
+		std::string name = unit.root_path.filename().string();
+		std::map<std::string, compiled>::const_iterator found = compiled_units.find(name);
+		if (found == compiled_units.end()) {
+			error.append(std::format("Unit \"{}\" was not compiled by any shard.", unit.root_path.string()));
+			continue;
+		}
+		std::uint64_t expected = fingerprint(compiler, unit, source_directory);
+		if (found->second.fingerprint != expected) {
+			error.append(std::format("Unit \"{}\" was compiled in \"{}\" with different compiler options (fingerprint {:016x}, now {:016x}).", unit.root_path.string(), found->second.directory.string(), found->second.fingerprint, expected));
+			continue;
+		}
+		const pgm::translation_unit &shard_unit = merged.emplace_back(unit.root_path, found->second.directory);
+		if (!std::filesystem::exists(shard_unit.object_path)) {
+			error.append(std::format("Object \"{}\" of unit \"{}\" is missing.", shard_unit.object_path.string(), unit.root_path.string()));
+		}
+	}
+	if (error) {
+		error.append(std::format("Error merging {} shard directories.", shard_directories.size()));
+		return std::vector<pgm::translation_unit>();
+	}
+	return merged;
+}
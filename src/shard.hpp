@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include "error.hpp"
+#include "compiler.hpp"
+#include "manifest.hpp"
+#include "translation_unit.hpp"
+
+namespace pgm {
+	// Splits the units of a build over several machines, e.g. CI nodes. Each compiles one part ("--shard K/N") and a final step links the objects of all parts ("--merge").
+	// Every shard must pick the same split without talking to the others, so the split only depends on the source file names and on compile times from a manifest every shard is given ("--shard-costs"). The shards own manifests differ between machines so they are never used.
+	class shard {
+		public:
+		// Units of shard index (counting from 0) out of count.
+		// With compile times recorded in costs, which must be the same manifest for every shard, the units are spread so every shard gets about the same total compile time, longest first onto the least loaded shard. Units without a time count as the average.
+		// Without any, e.g. when costs is an empty manifest, the shard of a unit is a hash of its file name, which doesn't move other units around when one is added.
+		// Units are named by their file name because sources are not searched recursively and objects are named by it too. Compile times are matched by file name too so costs can come from a build in another directory.
+		static std::vector<pgm::translation_unit>
+		select(const std::vector<pgm::translation_unit> &units, const pgm::manifest &costs, unsigned index, unsigned count);
+
+		// Fingerprint of the compile of unit that doesn't depend on where the checkout is, so shards built in different places can be compared.
+		// The source and object are relative to their directories and paths under source_directory or the working directory, e.g. absolute "-I" directories of the checkout, are rebased onto them.
+		// Other absolute paths, e.g. "-isystem /opt/sdk/include", must be the same for every shard.
+		static std::uint64_t
+		fingerprint(const pgm::compiler &compiler, const pgm::translation_unit &unit, const std::filesystem::path &source_directory);
+
+		// Path of the record of the shard built in object_directory.
+		static std::filesystem::path
+		record_path(const std::filesystem::path &object_directory);
+
+		// Records which of units the shard in object_directory compiled and with which fingerprint, for merge.
+		static void
+		record(const std::filesystem::path &object_directory, unsigned index, unsigned count, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &source_directory, error &error);
+
+		// Units to link with the objects of the shards in shard_directories.
+		// Checks that all shards of the split are there and that every unit in units was compiled by one of them with the fingerprint compiler gives it now. All problems are reported, not just the first.
+		static std::vector<pgm::translation_unit>
+		merge(const std::vector<std::filesystem::path> &shard_directories, const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, const std::filesystem::path &source_directory, error &error);
+	};
+}
@@ -2,8 +2,12 @@
 
 #include <format>
 #include <iostream>
+#include <ctime>
 
-pgm::translation_unit::translation_unit(const std::filesystem::path &root_path, const std::filesystem::path &object_directory) : root_path{root_path}, object_path{source_to_object(root_path, object_directory)} {}
+#include "compiler.hpp"
+#include "manifest.hpp"
+
+pgm::translation_unit::translation_unit(const std::filesystem::path &root_path, const std::filesystem::path &object_directory) : root_path{root_path}, object_path{source_to_object(root_path, object_directory)}, dependency_path{object_path.string() + ".d"} {}
 
 std::filesystem::path
 pgm::translation_unit::source_to_object(const std::filesystem::path &root_path, const std::filesystem::path &object_directory) {
@@ -11,11 +15,15 @@ pgm::translation_unit::source_to_object(const std::filesystem::path &root_path,
 }
 
 bool
-pgm::translation_unit::object_is_outdated(const pgm::compiler &compiler, error &error) const {
+pgm::translation_unit::object_is_outdated(pgm::scanner &scanner, error &error, trigger *trigger) const {
 	std::filesystem::file_time_type object_time;
 	do {
 		// If object file does not exist.
 		if (!std::filesystem::exists(object_path)) {
+			if (trigger != nullptr) {
+				trigger->cause = "object missing";
+				trigger->detail = std::format("object \"{}\" does not exist.", object_path.string());
+			}
 			// Add source and object to compilation vector.
 			return true;
 		}
@@ -26,6 +34,10 @@ pgm::translation_unit::object_is_outdated(const pgm::compiler &compiler, error &
 		} catch (const std::filesystem::filesystem_error &filesystem_error) {
 			// If object file does not exist.
 			if (filesystem_error.code() == std::errc::no_such_file_or_directory) {
+				if (trigger != nullptr) {
+					trigger->cause = "object missing";
+					trigger->detail = std::format("object \"{}\" does not exist.", object_path.string());
+				}
 				return true;
 			}
 
@@ -34,7 +46,8 @@ pgm::translation_unit::object_is_outdated(const pgm::compiler &compiler, error &
 		}
 
 		// Get headers that are #included in root file.
-		std::vector<std::string> prerequisites = compiler.get_make_prerequisites(root_path.string(), error);
+		// The scanner remembers prerequisites so other configurations with the same source don't scan again.
+		const std::vector<std::string> &prerequisites = scanner.prerequisites(*this, error);
 		if (error) {
 			break;
 		}
@@ -50,6 +63,10 @@ pgm::translation_unit::object_is_outdated(const pgm::compiler &compiler, error &
 			}
 			// std::cout << prerequisite << " " << time.time_since_epoch().count() << " " << object_time.time_since_epoch().count() << std::endl;
 			if (time > object_time) {
+				if (trigger != nullptr) {
+					trigger->cause = std::format("\"{}\" changed", prerequisite);
+					trigger->detail = std::format("\"{}\" modified {} is newer than object \"{}\" modified {}.", prerequisite, format_time(time), object_path.string(), format_time(object_time));
+				}
 				return true;
 			}
 		}
@@ -68,8 +85,29 @@ pgm::translation_unit::object_is_outdated(const pgm::compiler &compiler, error &
 	return false;
 }
 
+bool
+pgm::translation_unit::is_source(const std::filesystem::path &path) {
+	// https://gcc.gnu.org/onlinedocs/gcc-4.4.1/gcc/Overall-Options.html#index-file-name-suffix-71
+	static std::vector<std::string> valid_extensions {
+		".c",
+		".cc",
+		".cp",
+		".cxx",
+		".cpp",
+		".c++",
+		".C"
+	};
+	const std::string actual_extension(path.extension().string());
+	for (const std::string &valid_extension : valid_extensions) {
+		if (actual_extension == valid_extension) {
+			return true;
+		}
+	}
+	return false;
+}
+
 std::vector<pgm::translation_unit>
-pgm::translation_unit::find_all(const std::filesystem::path &source_directory, const std::filesystem::path &object_directory, error &error) {
+pgm::translation_unit::find_all(const std::filesystem::path &source_directory, const std::filesystem::path &object_directory, error &error, const std::vector<std::filesystem::path> &generated_paths) {
 	std::vector<pgm::translation_unit> units;
 
 	do {
@@ -92,25 +130,7 @@ pgm::translation_unit::find_all(const std::filesystem::path &source_directory, c
 			std::filesystem::path root_path(entry.path());
 
 			// Skip non-source files.
-			// https://gcc.gnu.org/onlinedocs/gcc-4.4.1/gcc/Overall-Options.html#index-file-name-suffix-71
-			static std::vector<std::string> valid_extensions {
-				".c",
-				".cc",
-				".cp",
-				".cxx",
-				".cpp",
-				".c++",
-				".C"
-			};
-			const std::string actual_extension(root_path.extension().string());
-			bool actual_is_invalid = true;
-			for (const std::string &valid_extension : valid_extensions) {
-				if (actual_extension == valid_extension) {
-					actual_is_invalid = false;
-					break;
-				}
-			}
-			if (actual_is_invalid) {
+			if (!is_source(root_path)) {
 				continue;
 			}
 			// Alternative looser regex implementation
@@ -121,6 +141,29 @@ pgm::translation_unit::find_all(const std::filesystem::path &source_directory, c
 
 			units.emplace_back(root_path, object_directory);
 		}
+
+		// Generated sources usually live outside the source directory, e.g. in a "gen" directory that is not committed.
+		std::vector<pgm::translation_unit>::size_type found = units.size();
+		for (const std::filesystem::path &generated_path : generated_paths) {
+			if (!is_source(generated_path)) {
+				continue;
+			}
+			std::error_code error_code;
+			bool duplicate = false;
+			for (std::vector<pgm::translation_unit>::size_type i = 0; i < units.size(); i++) {
+				if (units[i].root_path.filename() != generated_path.filename()) {
+					continue;
+				}
+				duplicate = true;
+				if (i >= found || !std::filesystem::equivalent(units[i].root_path, generated_path, error_code)) {
+					error.append(std::format("Generated source \"{}\" has the same file name as \"{}\" so their objects would overwrite each other.", generated_path.string(), units[i].root_path.string()));
+				}
+				break;
+			}
+			if (!duplicate) {
+				units.emplace_back(generated_path, object_directory);
+			}
+		}
 	} while (false);
 
 	if (error) {
@@ -130,12 +173,29 @@ pgm::translation_unit::find_all(const std::filesystem::path &source_directory, c
 }
 
 std::vector<pgm::translation_unit>
-pgm::translation_unit::find_changed(const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, error &error) {
+pgm::translation_unit::find_changed(const std::vector<pgm::translation_unit> &units, pgm::scanner &scanner, const pgm::compiler &compiler, const pgm::manifest &manifest, error &error, std::vector<trigger> *triggers) {
 	std::vector<pgm::translation_unit> changed_units;
 
 	for (const pgm::translation_unit &unit : units) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		pgm::translation_unit::trigger trigger;
+
+		// Changed flags make the object outdated even if no file changed.
+		std::uint32_t recorded = manifest.find(unit.root_path);
+		std::uint64_t fingerprint = compiler.fingerprint(unit);
+		if (recorded != pgm::manifest::no_unit && manifest.unit_fingerprint(recorded) != fingerprint) {
+			changed_units.push_back(unit);
+			if (triggers != nullptr) {
+				trigger.cause = "compiler options changed";
+				trigger.detail = std::format("object \"{}\" was compiled with different compiler options (fingerprint {:016x}, now {:016x}).", unit.object_path.string(), manifest.unit_fingerprint(recorded), fingerprint);
+				trigger.scan_time = std::chrono::steady_clock::now() - start;
+				triggers->push_back(std::move(trigger));
+			}
+			continue;
+		}
+
 		// Check if object is outdated.
-		bool object_is_outdated = unit.object_is_outdated(compiler, error);
+		bool object_is_outdated = unit.object_is_outdated(scanner, error, triggers != nullptr ? &trigger : nullptr);
 		if (error) {
 			error.append("Error finding changed translation units.");
 			return changed_units;
@@ -144,7 +204,30 @@ pgm::translation_unit::find_changed(const std::vector<pgm::translation_unit> &un
 		// If object is up to date.
 		if (object_is_outdated) {
 			changed_units.push_back(unit);
+			if (triggers != nullptr) {
+				trigger.scan_time = std::chrono::steady_clock::now() - start;
+				triggers->push_back(std::move(trigger));
+			}
 		}
 	}
 	return changed_units;
 }
+
+std::string
+pgm::translation_unit::format_time(std::filesystem::file_time_type time) {
+	std::chrono::system_clock::time_point system_time = std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(time));
+	std::time_t seconds = std::chrono::system_clock::to_time_t(system_time);
+	// Nanoseconds are shown because objects and headers written within the same second are common and that's exactly when the order matters.
+	long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(system_time.time_since_epoch() % std::chrono::seconds(1)).count();
+	if (nanoseconds < 0) {
+		nanoseconds += 1000000000;
+		seconds--;
+	}
+	std::tm local;
+	char date[32];
+	if (::localtime_r(&seconds, &local) == nullptr || std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local) == 0) {
+		return std::to_string(seconds);
+	}
+	std::string fraction = std::to_string(nanoseconds);
+	return std::string(date) + "." + std::string(9 - fraction.size(), '0') + fraction;
+}
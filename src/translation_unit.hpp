@@ -1,14 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <string>
 #include <vector>
 #include <filesystem>
 #include <system_error>
 
 #include "error.hpp"
-#include "compiler.hpp"
+#include "scanner.hpp"
 
 namespace pgm {
+	class scanner;
 	class compiler;
+	class manifest;
 
 	// Manages a translation unit unit and it's object file.
 	// A translaation unit typically refers to a source file after it has been pre-processed so all includes are resolved.
@@ -19,6 +23,18 @@ namespace pgm {
 		// root_path refers to the source file that, optionally, #include all of those headers.
 		const std::filesystem::path root_path;
 		const std::filesystem::path object_path; // Path of the object file that compilation should generate.
+		const std::filesystem::path dependency_path; // Path of the make rule listing the units prerequisites that compilation writes next to the object.
+
+		// Why a unit has to be recompiled. Reported by "--explain".
+		class trigger {
+			public:
+			// Short description shared by all units recompiled for the same reason, e.g. "\"header.hpp\" changed". Used to group the costs in the summary.
+			std::string cause;
+			// Full explanation for this unit with paths and modification times.
+			std::string detail;
+			// Time spent checking whether this unit is outdated, including scanning its prerequisites.
+			std::chrono::steady_clock::duration scan_time{};
+		};
 
 		translation_unit(const std::filesystem::path &root_path, const std::filesystem::path &object_directory);
 
@@ -27,18 +43,30 @@ namespace pgm {
 		source_to_object(const std::filesystem::path &root_path, const std::filesystem::path &object_directory);
 
 		// Checks if the object file for a translation unit is out of date or non-existant.
+		// If trigger is given it is filled in with the reason when the object is outdated.
 		bool
-		object_is_outdated(const pgm::compiler &compiler, error &error) const;
+		object_is_outdated(pgm::scanner &scanner, error &error, trigger *trigger = nullptr) const;
+
+		// True if path has the extension of a C or C++ source.
+		static bool
+		is_source(const std::filesystem::path &path);
 
 		// Find all translation_units in source_directory.
+		// The sources among generated_paths (outputs of pgm::generators) are added when they aren't in source_directory. Their file names must differ from the other sources because objects are named by them.
 		static
 		std::vector<pgm::translation_unit>
-		find_all(const std::filesystem::path &source_directory, const std::filesystem::path &object_directory, error &error);
+		find_all(const std::filesystem::path &source_directory, const std::filesystem::path &object_directory, error &error, const std::vector<std::filesystem::path> &generated_paths = {});
 
 		// Find changed translation_units in units.
-		// compiler is used to parse #include directives from translation units.
+		// scanner is used to parse #include directives from translation units.
+		// Units whose object was compiled with a different fingerprint than compiler would use now, according to manifest, are changed too.
+		// If triggers is given the reason for each changed unit is added to it, in the same order.
 		static
 		std::vector<pgm::translation_unit>
-		find_changed(const std::vector<pgm::translation_unit> &units, const pgm::compiler &compiler, error &error);
+		find_changed(const std::vector<pgm::translation_unit> &units, pgm::scanner &scanner, const pgm::compiler &compiler, const pgm::manifest &manifest, error &error, std::vector<trigger> *triggers = nullptr);
+
+		// Formats a modification time like "2024-01-31 13:45:00.123456789" in local time.
+		static std::string
+		format_time(std::filesystem::file_time_type time);
 	};
 }
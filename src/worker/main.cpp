@@ -0,0 +1,183 @@
+#include <iostream>
+#include <format>
+#include <fstream>
+#include <map>
+#include <string>
+#include <filesystem>
+
+#include <csignal>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../error.hpp"
+#include "../remote.hpp"
+#include "../job_pool.hpp"
+
+// Compiles one request received on connection and sends the response.
+// Runs in its own process so a crashing compiler or a slow client never blocks other connections.
+static void
+handle(int connection, const std::string &compiler) {
+	pgm::error error;
+	pgm::remote::response response;
+
+	// Temporary directory for the preprocessed input and the object output.
+	char directory_template[] = "/tmp/cromple-worker-XXXXXX";
+	std::filesystem::path directory;
+
+	do {
+		pgm::remote::request request = pgm::remote::read_request(connection, pgm::remote::default_timeout, error);
+		if (error) {
+			break;
+		}
+
+		// Anyone who can connect is trusted with code generation options only. Others could run programs or write files as the worker.
+		std::string rejected = pgm::remote::rejected_argument(request.arguments);
+		if (!rejected.empty()) {
+			error.append(std::format("Refusing compiler argument \"{}\". Workers only accept code generation and warning options.", rejected));
+			break;
+		}
+
+		// A compiler that can't be run fails every compile, which the client must not mistake for a compile error.
+		// Checked here because the forked child that fails to exec it exits like a failed compile.
+		if (::access(compiler.c_str(), X_OK) == -1) {
+			error.strerror().append(std::format("Can't run compiler \"{}\".", compiler));
+			break;
+		}
+
+		if (::mkdtemp(directory_template) == nullptr) {
+			error.strerror().append("Error creating temporary directory.");
+			break;
+		}
+		directory = directory_template;
+		std::filesystem::path input_path = directory / "unit.i";
+		std::filesystem::path object_path = directory / "unit.o";
+		{
+			std::ofstream input(input_path, std::ios::binary);
+			input.write(request.source.data(), static_cast<std::streamsize>(request.source.size()));
+			if (!input) {
+				error.append(std::format("Error writing preprocessed source to \"{}\".", input_path.string()));
+				break;
+			}
+		}
+
+		// The job pool drains stdout and stderr while the compiler runs so big diagnostics can't block it.
+		std::vector<std::string> command {compiler};
+		command.insert(command.end(), request.arguments.begin(), request.arguments.end());
+		command.insert(command.end(), {"-x", request.language, "-c", input_path, "-o", object_path});
+		std::vector<pgm::job_pool::job> jobs(1);
+		jobs[0].start = [command](pgm::error &error) {
+			return pgm::process::exec(command, error);
+		};
+		pgm::job_pool(1).run(jobs, error);
+		response.exit_status = jobs[0].exit_status;
+		response.diagnostics = jobs[0].stderr_output;
+		// A non-zero exit status is a compile error that belongs to the client. Anything else is a worker problem.
+		if (response.exit_status != 0) {
+			error = pgm::error();
+			break;
+		}
+		if (error) {
+			break;
+		}
+
+		std::ifstream object(object_path, std::ios::binary);
+		response.object.assign(std::istreambuf_iterator<char>(object), std::istreambuf_iterator<char>());
+	} while (false);
+
+	if (!directory.empty()) {
+		std::error_code error_code;
+		std::filesystem::remove_all(directory, error_code);
+	}
+
+	// The client tries another worker or compiles locally.
+	if (error) {
+		error.print();
+		response.worker_error = true;
+		response.exit_status = 1;
+		response.diagnostics = "cromple-worker: internal error, see the worker log.";
+	}
+
+	pgm::error write_error;
+	pgm::remote::write_response(connection, response, pgm::remote::default_timeout, write_error);
+	if (write_error) {
+		write_error.print();
+	}
+}
+
+int main(int argc, char *argv[]) {
+	// Default arguments
+	std::string compiler("/usr/bin/g++");
+	std::string address("127.0.0.1");
+	std::string port("7373");
+
+	std::map<std::string, std::string *> argument_pointers {
+		{"--compiler", &compiler},
+		{"--address",  &address },
+		{"--port",     &port    },
+	};
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg(argv[i]);
+		if (arg == "--help" || arg == "-h" || arg == "-?") {
+			std::cout
+				<< "Usage: cromple-worker [--compiler COMPILER (default: /usr/bin/g++)] [--address ADDRESS (default: 127.0.0.1)] [--port PORT (default: 7373, 0 picks a free port)]\n"
+				<< "Workers don't authenticate clients: anyone who can connect can use the compiler and the CPU time of the worker.\n"
+				<< "Only code generation and warning options are accepted so clients can't run programs or read or write files through compiler options.\n"
+				<< "Listen on \"--address 0.0.0.0\" only on networks where everyone is trusted with that."
+				<< std::endl;
+			return 0;
+		}
+		std::map<std::string, std::string *>::iterator flag_iterator = argument_pointers.find(arg);
+		if (flag_iterator == argument_pointers.end() || i + 1 == argc) {
+			return pgm::error(std::format("Unknown argument or missing value \"{}\". See \"--help\".", arg)).print();
+		}
+		*flag_iterator->second = argv[++i];
+	}
+
+	pgm::error error;
+
+	std::uint16_t port_number;
+	try {
+		port_number = static_cast<std::uint16_t>(std::stoul(port));
+	} catch (const std::exception &exception) {
+		return pgm::error(std::format("\"--port\" must be a number but got \"{}\".", port)).print();
+	}
+
+	int listener = pgm::remote::listen(address, port_number, error);
+	if (error) {
+		return error.print();
+	}
+
+	// Printed so scripts and tests using port 0 can find out where to connect.
+	std::cout << std::format("Listening on {}:{}", address, port_number) << std::endl;
+
+	// Reap connection handlers automatically.
+	std::signal(SIGCHLD, SIG_IGN);
+
+	while (true) {
+		int connection = ::accept(listener, nullptr, nullptr);
+		if (connection == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return error.strerror().append("Error accepting connection.").print();
+		}
+
+		pid_t pid = ::fork();
+		if (pid == -1) {
+			pgm::error().strerror().append("Error forking connection handler.").print();
+			::close(connection);
+			continue;
+		}
+		if (pid == 0) {
+			// Handlers wait for their own compiler so they need normal child reaping back.
+			std::signal(SIGCHLD, SIG_DFL);
+			::close(listener);
+			handle(connection, compiler);
+			::close(connection);
+			std::exit(0);
+		}
+		::close(connection);
+	}
+}
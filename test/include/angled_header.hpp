@@ -0,0 +1 @@
+// This is here to test if files are recompiled when a header that is included with angle brackets from a directory the native scanner doesn't know about is touched.
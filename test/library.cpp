@@ -0,0 +1,72 @@
+// Builds a project in process through libcromple like an IDE or test runner would.
+// Arguments are the same as cromple's. Exits with 0 and prints nothing if the library behaves.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "project.hpp"
+
+static int
+fail(const std::string &message) {
+	std::cerr << message << std::endl;
+	return 1;
+}
+
+int main(int argc, char *argv[]) {
+	pgm::error error;
+	pgm::arguments arguments = pgm::arguments::parse(std::vector<std::string>(argv + 1, argv + argc), error);
+	if (error) {
+		return error.print();
+	}
+	pgm::project project(arguments, error);
+	if (error) {
+		return error.print();
+	}
+
+	std::vector<pgm::project::unit> outdated = project.outdated(error);
+	if (error) {
+		return error.print();
+	}
+	if (outdated.empty() || project.up_to_date()) {
+		return fail("Expected outdated units.");
+	}
+
+	// Cancelling before compiling stops the next compile.
+	project.cancel();
+	project.compile(outdated, {}, error);
+	if (!error) {
+		return fail("compile did not stop after cancel.");
+	}
+	error = pgm::error();
+
+	std::size_t started = 0;
+	std::size_t finished = 0;
+	std::size_t linked = 0;
+	pgm::project::callbacks callbacks;
+	callbacks.started = [&started](const pgm::project::unit &unit) {
+		started++;
+	};
+	callbacks.finished = [&finished](const pgm::project::unit &unit, bool succeeded, std::chrono::steady_clock::duration duration) {
+		finished += succeeded;
+	};
+	callbacks.linked = [&linked](std::size_t configuration, std::chrono::steady_clock::duration duration) {
+		linked++;
+	};
+	project.compile(outdated, callbacks, error);
+	if (!error) {
+		project.link(callbacks, error);
+	}
+	if (error) {
+		return error.print();
+	}
+	if (started != outdated.size() || finished != outdated.size() || linked != arguments.configurations.size()) {
+		return fail("Callbacks were not called once per unit and configuration.");
+	}
+
+	// The same project sees its own build.
+	if (!project.up_to_date() || !project.outdated(error).empty() || error) {
+		return fail("Project is not up to date after building it.");
+	}
+	return 0;
+}
@@ -0,0 +1,6 @@
+// Module interface imported by main.cpp. Compiled first so its BMI exists when main.cpp is compiled.
+export module greeting;
+
+export const char *greeting() {
+	return "Hello World! I'm a module!";
+}
@@ -0,0 +1,7 @@
+#include <iostream>
+
+import greeting;
+
+int main() {
+	std::cout << greeting() << std::endl;
+}
@@ -6,6 +6,9 @@
 // Space in the header below to test parsing accuracy.
 #include "touch header.hpp"
 
+// Angle brackets but not a system header.
+#include <angled_header.hpp>
+
 int main() {
 	std::cout << get_string() << std::endl;
 }
@@ -4,11 +4,15 @@ import os
 import subprocess
 import pathlib
 import time
+import shutil
+import socket
+import json
 
 print("Testing...")
 
 repo_root = os.path.normpath(os.path.join(os.path.dirname(__file__), ".."))
 subject_executable = os.path.join(repo_root, "bin", "cromple")
+worker_executable = os.path.join(repo_root, "bin", "cromple-worker")
 
 # Test directories. (non-default to ensure options work)
 test_root = os.path.join(repo_root, "test")
@@ -21,15 +25,21 @@ main_source = os.path.join(source_directory, "main.cpp")
 main_object = os.path.join(object_directory, "main.cpp.o")
 test_executable = os.path.join(test_root, "executable")
 
-# Delete object files generated by previous tests.
+# Configurations used to test building several variants in one invocation.
+configuration_names = ["debug", "release"]
+
+# Delete object files, dependency files and manifests generated by previous tests.
 directory_iterator = os.scandir(object_directory)
 for entry in directory_iterator:
-	if entry.name.endswith(".o"):
+	if entry.is_dir():
+		shutil.rmtree(entry.path)
+	elif entry.name != ".gitignore":
 		os.remove(entry.path)
 
-# Delete executable generated by previous tests.
-if os.path.isfile(test_executable):
-	os.remove(test_executable)
+# Delete executables generated by previous tests.
+for executable in [test_executable, f"{test_executable}-modules", f"{test_executable}-merged", f"{test_executable}-lto"] + [f"{test_executable}-{name}" for name in configuration_names]:
+	if os.path.isfile(executable):
+		os.remove(executable)
 
 command = [subject_executable, "--compiler", "/usr/bin/g++", "--source", source_directory, "--objects", object_directory, "-I", include_directory, "-o", test_executable]
 print("Compilation command used in testing:", " ".join(command))
@@ -88,11 +98,387 @@ compile()
 if os.stat(main_object).st_mtime == mod_time:
 	raise SystemExit("main.cpp was not recompiled when deep_touch_header.hpp was touched.")
 
+print("Test that --explain names the header that caused a recompile.")
+time.sleep(1)
+pathlib.Path(os.path.join(include_directory, "touch header.hpp")).touch()
+explain = subprocess.run(command + ["--explain"], stdout=subprocess.PIPE, text=True, check=True)
+if f'"{include_directory}/touch header.hpp" changed' not in explain.stdout or f'Recompiling "{main_source}"' not in explain.stdout:
+	raise SystemExit(f"--explain did not report the touched header:\n{explain.stdout}")
+
+print("Test that nothing is recompiled or relinked when nothing has changed.")
+main_object_time = os.stat(main_object).st_mtime
+executable_time = os.stat(test_executable).st_mtime
+compile()
+if os.stat(main_object).st_mtime != main_object_time or os.stat(test_executable).st_mtime != executable_time:
+	raise SystemExit("Object or executable was written by a no-op build.")
+
+print("Test that objects are recompiled when compiler options change.")
+main_object_time = os.stat(main_object).st_mtime
+subprocess.run(command + ["-DCHANGED_OPTION"], check=True)
+if os.stat(main_object).st_mtime == main_object_time:
+	raise SystemExit("main.cpp was not recompiled when compiler options changed.")
+compile()
+
+print("Test that --overrides only recompiles the units whose options it changes.")
+overrides_path = os.path.join(object_directory, "overrides")
+with open(overrides_path, "w") as overrides_file:
+	overrides_file.write("# Comments and empty lines are skipped.\n\nsymlink.* -DOVERRIDDEN\n")
+symlink_object = os.path.join(object_directory, "symlink.c.o")
+main_object_time = os.stat(main_object).st_mtime
+symlink_object_time = os.stat(symlink_object).st_mtime
+subprocess.run(command + ["--overrides", overrides_path], check=True)
+if os.stat(main_object).st_mtime != main_object_time or os.stat(symlink_object).st_mtime == symlink_object_time:
+	raise SystemExit("Overriding the options of symlink.c did not recompile only symlink.c.")
+# The options reach the compiler.
+with open(overrides_path, "w") as overrides_file:
+	overrides_file.write("main.cpp -fno-such-option\n")
+if subprocess.run(command + ["--overrides", overrides_path], stderr=subprocess.DEVNULL).returncode == 0:
+	raise SystemExit("An invalid option in overrides did not fail the compile of main.cpp.")
+compile()
+
+print("Test that generators only run when their inputs change and generated sources are compiled.")
+generator_input = os.path.join(object_directory, "generator-input.txt")
+generated_source = os.path.join(object_directory, "generated", "generated.cpp")
+generator_log = os.path.join(object_directory, "generator-log")
+generators_path = os.path.join(object_directory, "generators")
+with open(generator_input, "w") as input_file:
+	input_file.write("int generated() { return 0; }\n")
+with open(generators_path, "w") as generators_file:
+	generators_file.write(f"generator copy\ninputs {object_directory}/*.txt\noutputs {generated_source}\ncommand cp {generator_input} {generated_source} && echo ran >> {generator_log}\n")
+generator_command = command + ["--generators", generators_path]
+subprocess.run(generator_command, check=True)
+generated_object = os.path.join(object_directory, "generated.cpp.o")
+if not os.path.isfile(generated_object):
+	raise SystemExit("Generated source was not compiled.")
+subprocess.run(generator_command, check=True)
+generated_object_time = os.stat(generated_object).st_mtime
+generated_source_time = os.stat(generated_source).st_mtime
+time.sleep(1)
+# Touching the input runs the generator again but the output has the same contents so nothing is recompiled.
+pathlib.Path(generator_input).touch()
+subprocess.run(generator_command, check=True)
+with open(generator_log) as log_file:
+	runs = len(log_file.readlines())
+if runs != 2:
+	raise SystemExit(f"Generator ran {runs} times instead of once for the first build and once for the touched input.")
+if os.stat(generated_source).st_mtime != generated_source_time or os.stat(generated_object).st_mtime != generated_object_time:
+	raise SystemExit("Identical generated source was rewritten or recompiled.")
+compile()
+
+print("Test that the native scanner finds the same prerequisites as the compiler.")
+def remove_scan_results():
+	# Dependency files and the manifest would answer without scanning.
+	for entry in os.scandir(object_directory):
+		if entry.name.endswith(".d") or entry.name == "cromple.manifest":
+			os.remove(entry.path)
+remove_scan_results()
+verify = subprocess.run(command + ["--scanner", "verify"], stderr=subprocess.PIPE, text=True)
+if verify.returncode != 0 or "Native scanner" in verify.stderr:
+	raise SystemExit(f"Native scanner disagreed with the compiler:\n{verify.stderr}")
+
+print("Test that the native scanner finds nested headers.")
+remove_scan_results()
+mod_time = os.stat(main_object).st_mtime
+time.sleep(1)
+pathlib.Path(os.path.join(include_directory, "deep_touch_header.hpp")).touch()
+subprocess.run(command + ["--scanner", "native"], check=True)
+if os.stat(main_object).st_mtime == mod_time:
+	raise SystemExit("main.cpp was not recompiled when deep_touch_header.hpp was touched and scanned natively.")
+
+print("Test that the native scanner doesn't take a conditional block for an include guard.")
+# feature.hpp starts like a guarded header but FEATURE is defined by main.cpp, so the compiler never reads fallback.hpp.
+conditional_directory = os.path.join(object_directory, "conditional")
+conditional_sources = os.path.join(conditional_directory, "source")
+os.makedirs(conditional_sources)
+with open(os.path.join(conditional_sources, "main.cpp"), "w") as file:
+	file.write("#define FEATURE\n#include \"feature.hpp\"\nint main() {}\n")
+with open(os.path.join(conditional_sources, "feature.hpp"), "w") as file:
+	file.write("#ifndef FEATURE\n#include \"fallback.hpp\"\n#endif\n")
+with open(os.path.join(conditional_sources, "fallback.hpp"), "w") as file:
+	file.write("#error fallback.hpp must not be included\n")
+conditional_command = [subject_executable, "--compiler", "/usr/bin/g++", "--source", conditional_sources, "--objects", conditional_directory, "-o", os.path.join(conditional_directory, "executable")]
+subprocess.run(conditional_command, check=True)
+# Without a dependency file or manifest the unit has to be scanned.
+os.remove(os.path.join(conditional_directory, "main.cpp.o.d"))
+os.remove(os.path.join(conditional_directory, "cromple.manifest"))
+conditional = subprocess.run(conditional_command + ["--scanner", "verify"], stderr=subprocess.PIPE, text=True)
+if conditional.returncode != 0 or "Native scanner is unsure" not in conditional.stderr:
+	raise SystemExit(f"Native scanner trusted a conditional block as an include guard:\n{conditional.stderr}")
+
+print("Test that the native scanner asks the compiler about angled includes it can't find.")
+# --include-directory is understood by the compiler but not by the native scanner, so <angled_header.hpp> is only found by the compiler.
+include_option = command.index("-I")
+unknown_include_command = command[:include_option] + ["-iquote", include_directory, f"--include-directory={include_directory}"] + command[include_option + 2:]
+subprocess.run(unknown_include_command, check=True)
+remove_scan_results()
+mod_time = os.stat(main_object).st_mtime
+time.sleep(1)
+pathlib.Path(os.path.join(include_directory, "angled_header.hpp")).touch()
+subprocess.run(unknown_include_command + ["--scanner", "native"], check=True)
+if os.stat(main_object).st_mtime == mod_time:
+	raise SystemExit("main.cpp was not recompiled when angled_header.hpp, found by an include option the native scanner doesn't know, was touched.")
+
+print("Test that --graph ranks headers by the units that depend on them.")
+graph_path = os.path.join(object_directory, "graph.json")
+subprocess.run(command + ["--graph", graph_path], stdout=subprocess.DEVNULL, check=True)
+with open(graph_path) as graph_file:
+	graph = json.load(graph_file)
+fan_in = {header["path"]: header["fan_in"] for header in graph["headers"]}
+# header.hpp is included by both sources, "touch header.hpp" only by main.cpp.
+if fan_in.get(os.path.join(source_directory, "header.hpp")) != 2 or fan_in.get(os.path.join(include_directory, "touch header.hpp")) != 1:
+	raise SystemExit(f"--graph reported wrong fan-in: {fan_in!r}.")
+
+print("Test that --profile aggregates the compile time reports of all units.")
+profile_path = os.path.join(object_directory, "profile.json")
+for object_file in object_files:
+	os.remove(os.path.join(object_directory, object_file))
+subprocess.run(command + ["--profile", profile_path], stdout=subprocess.DEVNULL, check=True)
+# Reports are kept next to the objects so a no-op build still profiles every unit.
+subprocess.run(command + ["--profile", profile_path], stdout=subprocess.DEVNULL, check=True)
+with open(profile_path) as profile_file:
+	profile = json.load(profile_file)
+# GCC only reports its passes. Every unit goes through parsing.
+parsing = [entry for entry in profile["entries"] if entry["name"] == "phase parsing"]
+if profile["units"] != len(object_files) or len(parsing) != 1 or parsing[0]["count"] != len(object_files):
+	raise SystemExit(f"--profile did not aggregate the reports of all units: {profile!r}.")
+
+print("Test that warnings of up to date objects are printed again without recompiling.")
+# Redefining a builtin macro warns in every unit.
+warning_command = command + ["-D__DATE__=0"]
+subprocess.run(warning_command, stderr=subprocess.DEVNULL, check=True)
+main_object_time = os.stat(main_object).st_mtime
+replay = subprocess.run(warning_command, stderr=subprocess.PIPE, text=True, check=True)
+if os.stat(main_object).st_mtime != main_object_time or "-Wbuiltin-macro-redefined" not in replay.stderr:
+	raise SystemExit(f"Warnings were not replayed by a no-op build:\n{replay.stderr}")
+compile()
+
 print("Test that executable works.")
 popen = subprocess.Popen(test_executable)
 popen.wait()
 if popen.returncode != 0:
 	raise SystemExit(f"Test executable exited with non-zero return code {popen.returncode}.")
 
+print("Test that several configurations are built in one invocation.")
+configuration_command = command[:]
+for name, flag in zip(configuration_names, ["-O0", "-O2"]):
+	configuration_command += ["--config", name, flag]
+subprocess.run(configuration_command, check=True)
+for name in configuration_names:
+	object_path = os.path.join(object_directory, name, "main.cpp.o")
+	if not os.path.isfile(object_path):
+		raise SystemExit(f"Configuration {name!r} object file was not created: {object_path!r}.")
+	if subprocess.run(f"{test_executable}-{name}").returncode != 0:
+		raise SystemExit(f"Configuration {name!r} executable did not run successfully.")
+
+print("Test that units are compiled on workers.")
+# The worker's compiler logs every compile so a build that silently fell back to local compiles fails the test.
+worker_compiler = os.path.join(object_directory, "worker-g++")
+worker_log = os.path.join(object_directory, "worker-g++.log")
+with open(worker_compiler, "w") as file:
+	file.write(f"#!/bin/sh\necho \"$@\" >> {worker_log}\nexec /usr/bin/g++ \"$@\"\n")
+os.chmod(worker_compiler, 0o755)
+worker = subprocess.Popen([worker_executable, "--compiler", worker_compiler, "--address", "127.0.0.1", "--port", "0"], stdout=subprocess.PIPE, text=True)
+try:
+	worker_address = worker.stdout.readline().split()[-1]
+	# The second address has nothing listening so compiles starting there must move on to the working worker.
+	unused_socket = socket.socket()
+	unused_socket.bind(("127.0.0.1", 0))
+	unused_address = f"127.0.0.1:{unused_socket.getsockname()[1]}"
+	for object_file in object_files:
+		os.remove(os.path.join(object_directory, object_file))
+	subprocess.run(command + ["--workers", f"{worker_address},{unused_address}"], check=True)
+	if subprocess.run(test_executable).returncode != 0:
+		raise SystemExit("Executable compiled on workers did not run successfully.")
+	with open(worker_log) as file:
+		worker_compiles = file.read().splitlines()
+	if len(worker_compiles) != len(object_files):
+		raise SystemExit(f"Expected the worker to compile {len(object_files)} units but it compiled {len(worker_compiles)}: {worker_compiles!r}.")
+	# Only the local compiler was checked for it. A worker with clang or GCC 15 would fail every unit.
+	if any("-fdiagnostics-format" in compile for compile in worker_compiles):
+		raise SystemExit(f"Diagnostic format of the local compiler was sent to the worker: {worker_compiles!r}.")
+
+	print("Test that workers refuse arguments that could run programs or write files.")
+	def frame(data):
+		return len(data).to_bytes(8, "little") + data
+	def read_frame(connection):
+		data = b""
+		while len(data) < 8:
+			data += connection.recv(8 - len(data))
+		length = int.from_bytes(data, "little")
+		data = b""
+		while len(data) < length:
+			data += connection.recv(length - len(data))
+		return data
+	for argument in ["-wrapper", "-fplugin=/tmp/plugin.so", "-Wl,-o,/tmp/file", "-o", "@/etc/passwd", "-specs=/tmp/specs"]:
+		host, port = worker_address.rsplit(":", 1)
+		with socket.create_connection((host, int(port))) as connection:
+			arguments = [argument, "/bin/true"]
+			connection.sendall(b"".join(frame(part.encode()) for part in ["cromple-remote 2", "c++-cpp-output", str(len(arguments))] + arguments + ["int main() {}\n"]))
+			outcome = read_frame(connection)
+		if outcome != b"worker error":
+			raise SystemExit(f"Worker accepted argument {argument!r}: {outcome!r}.")
+	with open(worker_log) as file:
+		if len(file.read().splitlines()) != len(object_files):
+			raise SystemExit("Worker ran its compiler for a request with a refused argument.")
+
+	print("Test that units are compiled locally when a worker can't run its compiler.")
+	broken_worker = subprocess.Popen([worker_executable, "--compiler", os.path.join(object_directory, "missing-g++"), "--address", "127.0.0.1", "--port", "0"], stdout=subprocess.PIPE, text=True)
+	try:
+		broken_worker_address = broken_worker.stdout.readline().split()[-1]
+		for object_file in object_files:
+			os.remove(os.path.join(object_directory, object_file))
+		subprocess.run(command + ["--workers", broken_worker_address], check=True)
+		if subprocess.run(test_executable).returncode != 0:
+			raise SystemExit("Executable compiled after a worker error did not run successfully.")
+	finally:
+		broken_worker.terminate()
+
+	print("Test that units are compiled locally when a worker stalls.")
+	# Accepts connections but never answers.
+	stalled_socket = socket.socket()
+	stalled_socket.bind(("127.0.0.1", 0))
+	stalled_socket.listen()
+	for object_file in object_files:
+		os.remove(os.path.join(object_directory, object_file))
+	start = time.monotonic()
+	subprocess.run(command + ["--workers", f"127.0.0.1:{stalled_socket.getsockname()[1]}", "--worker-timeout", "1"], check=True, timeout=60)
+	if time.monotonic() - start > 30:
+		raise SystemExit("Build with a stalled worker took longer than its timeout allows.")
+	if subprocess.run(test_executable).returncode != 0:
+		raise SystemExit("Executable compiled after a worker timed out did not run successfully.")
+	stalled_socket.close()
+
+	print("Test that units are compiled locally when no worker is reachable.")
+	worker.terminate()
+	worker.wait()
+	for object_file in object_files:
+		os.remove(os.path.join(object_directory, object_file))
+	subprocess.run(command + ["--workers", unused_address], check=True)
+	if subprocess.run(test_executable).returncode != 0:
+		raise SystemExit("Executable compiled after falling back to local compiles did not run successfully.")
+	unused_socket.close()
+finally:
+	worker.terminate()
+
+print("Test that libcromple builds a project in process.")
+library_client = os.path.join(object_directory, "library-client")
+subprocess.run(["/usr/bin/g++", "-std=c++20", "-I", os.path.join(repo_root, "src"), os.path.join(test_root, "library.cpp"), os.path.join(repo_root, "bin", "libcromple.a"), "-o", library_client], check=True)
+for object_file in object_files:
+	os.remove(os.path.join(object_directory, object_file))
+if subprocess.run([library_client] + command[1:]).returncode != 0:
+	raise SystemExit("libcromple did not build the project.")
+if subprocess.run(test_executable).returncode != 0:
+	raise SystemExit("Executable built by libcromple did not run successfully.")
+
+print("Test that shards compile disjoint parts of the units and merge links them.")
+shard_directories = [os.path.join(object_directory, f"shard-{k}") for k in [1, 2]]
+def shard_command(k, extra = []):
+	os.makedirs(shard_directories[k - 1], exist_ok=True)
+	return command + extra + ["--objects", shard_directories[k - 1], "--shard", f"{k}/2"]
+for k in [1, 2]:
+	subprocess.run(shard_command(k), check=True)
+shard_objects = [sorted(name for name in os.listdir(directory) if name.endswith(".o")) for directory in shard_directories]
+if sorted(shard_objects[0] + shard_objects[1]) != sorted(object_files):
+	raise SystemExit(f"Shards did not compile every unit exactly once: {shard_objects!r}.")
+merged_executable = f"{test_executable}-merged"
+merge_command = command + ["--merge", ",".join(shard_directories), "-o", merged_executable]
+subprocess.run(merge_command, check=True)
+if subprocess.run(merged_executable).returncode != 0:
+	raise SystemExit("Executable merged from shards did not run successfully.")
+
+print("Test that shards given the same costs split by compile time.")
+# With two units on two shards balancing by compile time always gives each shard one unit.
+costs = os.path.join(object_directory, "cromple.manifest")
+costs_directories = [os.path.join(object_directory, f"shard-costs-{k}") for k in [1, 2]]
+for k in [1, 2]:
+	os.makedirs(costs_directories[k - 1])
+	subprocess.run(command + ["--objects", costs_directories[k - 1], "--shard", f"{k}/2", "--shard-costs", costs], check=True)
+costs_objects = [sorted(name for name in os.listdir(directory) if name.endswith(".o")) for directory in costs_directories]
+if len(costs_objects[0]) != 1 or sorted(costs_objects[0] + costs_objects[1]) != sorted(object_files):
+	raise SystemExit(f"Shards given costs did not get one unit each: {costs_objects!r}.")
+if subprocess.run(command + ["--objects", costs_directories[0], "--shard", "1/2", "--shard-costs", os.path.join(object_directory, "missing.manifest")], stderr=subprocess.DEVNULL).returncode == 0:
+	raise SystemExit("Shard succeeded with missing costs.")
+
+print("Test that invalid shards are rejected.")
+for invalid_shard in ["1/-1", "-1/2", "+1/2", "0/2", "3/2", "1/99999999999", "1/2x", " 1/2", "1/"]:
+	if subprocess.run(command + ["--shard", invalid_shard], stderr=subprocess.DEVNULL).returncode == 0:
+		raise SystemExit(f"\"--shard {invalid_shard}\" was accepted.")
+
+print("Test that merge fails when a shard is missing or used other compiler options.")
+if subprocess.run(command + ["--merge", shard_directories[0], "-o", merged_executable], stderr=subprocess.DEVNULL).returncode == 0:
+	raise SystemExit("Merge succeeded without shard 2/2.")
+# Every shard records its units, even one that compiled none of them.
+shard_with_units = 1 if shard_objects[0] else 2
+subprocess.run(shard_command(shard_with_units, ["-DCHANGED_OPTION"]), check=True)
+merge = subprocess.run(merge_command, stderr=subprocess.PIPE, text=True)
+if merge.returncode == 0 or "different compiler options" not in merge.stderr:
+	raise SystemExit(f"Merge did not report the shard compiled with other options: {merge.stderr!r}.")
+
+print("Test that shards built in checkouts at different paths merge.")
+# Each checkout has its own absolute include directory, like CI machines checking out to different paths.
+checkouts = [os.path.join(object_directory, f"checkout-{k}") for k in [1, 2]]
+for checkout in checkouts:
+	shutil.copytree(source_directory, os.path.join(checkout, "source"), symlinks=True)
+	shutil.copytree(include_directory, os.path.join(checkout, "include"))
+	shutil.copy(os.path.join(test_root, "symlinked.c"), checkout)
+	os.makedirs(os.path.join(checkout, "objects"))
+def checkout_command(checkout):
+	return [subject_executable, "--compiler", "/usr/bin/g++", "--source", os.path.join(checkout, "source"), "--objects", os.path.join(checkout, "objects"), "-I", os.path.join(checkout, "include")]
+# Costs give each shard one unit so both checkouts' fingerprints are compared.
+for k, checkout in enumerate(checkouts, 1):
+	subprocess.run(checkout_command(checkout) + ["--shard", f"{k}/2", "--shard-costs", costs], cwd=checkout, check=True)
+checkout_executable = os.path.join(checkouts[0], "executable")
+merge = subprocess.run(checkout_command(checkouts[0]) + ["--merge", ",".join(os.path.join(checkout, "objects") for checkout in checkouts), "-o", checkout_executable], cwd=checkouts[0], stderr=subprocess.PIPE, text=True)
+if merge.returncode != 0 or subprocess.run(checkout_executable).returncode != 0:
+	raise SystemExit(f"Shards built in different checkouts did not merge: {merge.stderr!r}.")
+
+print("Test that --lto links with link time optimization and reports its cost.")
+lto_object_directory = os.path.join(object_directory, "lto")
+os.makedirs(lto_object_directory)
+lto = subprocess.run(command + ["--lto", "-O2", "--objects", lto_object_directory, "-o", f"{test_executable}-lto"], stdout=subprocess.PIPE, text=True, check=True)
+if "Link time optimization of" not in lto.stdout:
+	raise SystemExit(f"--lto did not report the link time optimization cost:\n{lto.stdout}")
+if subprocess.run(f"{test_executable}-lto").returncode != 0:
+	raise SystemExit("Executable linked with link time optimization did not run successfully.")
+
+print("Test that modules are compiled before their importers.")
+module_source_directory = os.path.join(test_root, "modules")
+module_object_directory = os.path.join(object_directory, "modules")
+module_executable = f"{test_executable}-modules"
+# Module dependencies are scanned with P1689 output which needs GCC 14 or later.
+if subprocess.run(["/usr/bin/g++", "-std=c++20", "-fmodules-ts", "-fdeps-format=p1689r5", "-E", "-x", "c++", "/dev/null", "-o", "/dev/null"], stderr=subprocess.DEVNULL).returncode != 0:
+	print("Skipped because the compiler can't write P1689 module dependencies.")
+else:
+	os.mkdir(module_object_directory)
+	module_command = [subject_executable, "--compiler", "/usr/bin/g++", "--source", module_source_directory, "--objects", module_object_directory, "--modules", "-std=c++20", "-o", module_executable]
+	subprocess.run(module_command, check=True)
+	if subprocess.run(module_executable).returncode != 0:
+		raise SystemExit("Executable built from modules did not run successfully.")
+	interface_object = os.path.join(module_object_directory, "greeting.cpp.o")
+	importer_object = os.path.join(module_object_directory, "main.cpp.o")
+
+	print("Test that importers are recompiled when a module interface changes.")
+	importer_time = os.stat(importer_object).st_mtime
+	time.sleep(1)
+	pathlib.Path(os.path.join(module_source_directory, "greeting.cpp")).touch()
+	subprocess.run(module_command, check=True)
+	if os.stat(importer_object).st_mtime == importer_time:
+		raise SystemExit("main.cpp was not recompiled when the module it imports changed.")
+
+	print("Test that a deleted BMI is rebuilt.")
+	bmi = os.path.join(module_object_directory, "modules", "greeting.gcm")
+	os.remove(bmi)
+	subprocess.run(module_command, check=True)
+	if not os.path.isfile(bmi):
+		raise SystemExit("The deleted BMI of greeting.cpp was not rebuilt.")
+
+	print("Test that module interfaces are not recompiled when only an importer changes.")
+	interface_time = os.stat(interface_object).st_mtime
+	time.sleep(1)
+	pathlib.Path(os.path.join(module_source_directory, "main.cpp")).touch()
+	subprocess.run(module_command, check=True)
+	if os.stat(interface_object).st_mtime != interface_time:
+		raise SystemExit("greeting.cpp was recompiled when only its importer changed.")
+
 print("All tests passed.")
 